@@ -0,0 +1,61 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include "avlbst.h"
+#include "bench-utils.h"
+
+using namespace std;
+
+// Many short lived trees, as when every request builds its own: each one is
+// filled with treeSize random keys, searched and thrown away. Nodes come from
+// operator new/delete or from a MonotonicTreeResource arena that is released
+// after every tree (see bst-memory.h).
+// Usage: ./arena-bench [treeSize] [numTrees]
+
+struct RunRequests
+{
+    RunRequests(bool a, uint64_t s, uint64_t n) : arena(a), treeSize(s), numTrees(n) {}
+
+    // Returns ns per tree
+    double operator()() const
+    {
+        MonotonicTreeResource resource(treeSize * sizeof(AVLNode<uint64_t, uint64_t>));
+        BenchRandom rng(1);
+        uint64_t found = 0;
+        BenchTimer timer;
+        for(uint64_t t = 0; t < numTrees; ++t) {
+            {
+                AVLTree<uint64_t, uint64_t> tree(arena ? &resource : NULL);
+                for(uint64_t i = 0; i < treeSize; ++i) {
+                    tree.insert(make_pair(rng.below(4 * treeSize), i));
+                }
+                for(uint64_t i = 0; i < treeSize; ++i) {
+                    found += (tree.find(rng.below(4 * treeSize)) != tree.end());
+                }
+            }
+            resource.release();
+        }
+        double secs = timer.elapsedSec();
+        benchKeep(found);
+        return secs * 1e9 / numTrees;
+    }
+
+    bool arena;
+    uint64_t treeSize;
+    uint64_t numTrees;
+};
+
+int main(int argc, char *argv[])
+{
+    uint64_t treeSize = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000;
+    uint64_t numTrees = argc > 2 ? strtoull(argv[2], NULL, 10) : 20000;
+
+    cout << "tree_size,trees,new_delete_us,arena_us,speedup" << endl;
+    for(uint64_t size = 10; size <= treeSize; size *= 10) {
+        uint64_t trees = numTrees * (treeSize / size);
+        double heap = runIsolated(RunRequests(false, size, trees));
+        double arena = runIsolated(RunRequests(true, size, trees));
+        cout << size << "," << trees << "," << heap / 1e3 << "," << arena / 1e3 << "," << heap / arena << endl;
+    }
+    return 0;
+}
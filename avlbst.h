@@ -6,6 +6,7 @@
 #include <cstdlib>
 #include <cstdint>
 #include <algorithm>
+#include <vector>
 #include "bst.h"
 
 struct KeyError { };
@@ -20,7 +21,7 @@ class AVLNode : public Node<Key, Value>
 {
 public:
     // Constructor/destructor.
-    AVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    AVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent, TreeMemoryResource* resource = NULL);
     virtual ~AVLNode();
 
     // Getter/setter for the node's height.
@@ -49,8 +50,8 @@ protected:
 * An explicit constructor to initialize the elements by calling the base class constructor
 */
 template<class Key, class Value>
-AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value> *parent) :
-    Node<Key, Value>(key, value, parent), balance_(0)
+AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value> *parent, TreeMemoryResource* resource) :
+    Node<Key, Value>(key, value, parent, resource), balance_(0)
 {
 
 }
@@ -126,106 +127,56 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
   -----------------------------------------------
 */
 
-
-template <class Key, class Value>
-class AVLTree : public BinarySearchTree<Key, Value>
+/**
+* The AVL rebalancing after an insert or a remove, written once over a
+* node-access policy so that trees whose nodes link to each other in other
+* ways share it: AVLTree over AVLNode pointers (AVLTree::Links) and
+* PersistentAVLTree over offsets into its file (mmap-avlbst.h). On top of
+* what rotateLeft needs (see bst.h) the policy reads and writes balances
+* with balance() and setBalance(), rotates with leftRotation() and
+* rightRotation() and is told of every removeFix step by countRemoveFix().
+*/
+template <class Links>
+struct AVLAlgorithms
 {
-public:
-    virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
-    virtual void remove(const Key& key);  // TODO
-protected:
-    virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
-
-    // Add helper functions here
-		void balanceCheck(AVLNode< Key, Value> *current);
-		void leftRotation(AVLNode< Key, Value> *current);
-		void rightRotation(AVLNode< Key, Value> *current);
-		void removeFix(AVLNode<Key,Value>* n, int difference);
+    typedef typename Links::NodePtr NodePtr;
 
+    static void balanceCheck(Links& links, NodePtr current);
+    static void removeFix(Links& links, NodePtr n, int difference);
+    static NodePtr unlink(Links& links, NodePtr current, int& difference);
 };
 
-/*
- * Recall: If key is already in the tree, you should 
- * overwrite the current value with the updated value.
- */
-template<class Key, class Value>
-void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
-{
-  // TODO
-	if (this->root_==nullptr){
-		this->root_= new AVLNode<Key,Value> (new_item.first, new_item.second, nullptr);
-		return; 
-	}
-
-	//CASE 1: If KEY is already in the tree, we will find it and update it's value
-		AVLNode<Key,Value> *found= static_cast<AVLNode<Key,Value>*>(this->internalFind(new_item.first)); 
-		if (found!=nullptr){ //If KEY found
-			found->setValue(new_item.second); //Updating the VALUE
-			return;
-		}
-
-		//CASE 2: If the KEY doesn't already exist we insert normally
-
-		AVLNode<Key, Value> *temp= static_cast<AVLNode<Key,Value>*>(this->root_); //We can access the root itself
-		AVLNode<Key, Value> *parent= nullptr; //this is going to be our parent that updates as we go through the tree
-
-		const Key& keyNew=new_item.first; //This is our new KEY to insert
-		const Value& valueNew=new_item.second; //This is our new VALUE to insert
-
-		while (temp!= NULL){ 
-			parent=temp; //move down
-			if(keyNew>temp->getKey()){ //If the new KEY is greater than the temporary one, calling the getter on the actual node
-				temp=temp->getRight(); //We move to the right
-			}
-			else if (keyNew< temp->getKey()){ //If the new KEY is smaller than the temporary one, 
-				temp=temp->getLeft(); //We move left
-			}
-		}
-
-		//This is where we reached the leaf node to insert, we found where we are going to insert
-		AVLNode<Key, Value> *toInsert= new AVLNode<Key, Value>(keyNew, valueNew, parent); 
-		toInsert->setBalance(0);
-
-		//Checking whether we should insert it to the left or right of the parent
-		if(keyNew<parent->getKey()){
-				parent->setLeft(toInsert); 
-		}else{
-			parent->setRight(toInsert);
-		}
-
-		//NOW CHECKING BALANCE
-		balanceCheck(toInsert); 
-}
-
-
-
-template<class Key, class Value>
-void AVLTree<Key, Value>::balanceCheck(AVLNode< Key, Value> *current)
+/**
+* Walks up from current, a node just linked in as a leaf, updating balances
+* until one becomes 0 or a single or double rotation fixes the subtree.
+*/
+template<class Links>
+void AVLAlgorithms<Links>::balanceCheck(Links& links, NodePtr current)
 {
-	AVLNode<Key, Value> *parent= current->getParent(); 
+	NodePtr parent= links.parent(current); 
 
 	//We keep checking till we reach the root node 
 	while (parent!=NULL){ 
 
 		//CASE 1:If we added to the left subtree, the balance of the parent increases
-		if (parent->getLeft()==current){ 
-				parent->updateBalance(1);
+		if (links.left(parent)==current){ 
+				links.setBalance(parent, links.balance(parent)+1);
 			}
 		//CASE 2: If we added to the right subtree, the balance of the parent decreases
-		else if (parent->getRight()==current){ 
-			parent->updateBalance(-1);
+		else if (links.right(parent)==current){ 
+			links.setBalance(parent, links.balance(parent)-1);
 		}
 
 		//Now we check for balances: 
 		//CASE 1: if balance is 0, we can stop and no rotation is needed. 
-		if (0==parent->getBalance()){
+		if (0==links.balance(parent)){
 			return; 
 		}
 
 		//CASE 2: if balance is -1 or 1, we keep moving up to check for parents 
-		else if (parent->getBalance()==-1 || parent->getBalance()==1){
+		else if (links.balance(parent)==-1 || links.balance(parent)==1){
 			current=parent; 
-			parent= parent->getParent(); 
+			parent= links.parent(parent); 
 			continue;
 		}
 
@@ -234,75 +185,75 @@ void AVLTree<Key, Value>::balanceCheck(AVLNode< Key, Value> *current)
 		//With single rotations, the balance updates are simply 0
 
 		//This is LR Imbalance
-		if (parent->getBalance()==-2 && current->getBalance()==1){
+		if (links.balance(parent)==-2 && links.balance(current)==1){
 
 			//We need to save the grandcild balances to determine the balance updates
-			AVLNode<Key,Value> *gChild= current->getLeft();
+			NodePtr gChild= links.left(current);
 			int grandChildB= 0; 
 			if (gChild!=nullptr){
-				grandChildB= gChild->getBalance(); 
+				grandChildB= links.balance(gChild); 
 			}
-			rightRotation(current);
-			leftRotation(parent);
+			links.rightRotation(current);
+			links.leftRotation(parent);
 
 			if (grandChildB==0){
-				current->setBalance(0);
-				parent->setBalance(0);
-				gChild->setBalance(0);
+				links.setBalance(current, 0);
+				links.setBalance(parent, 0);
+				links.setBalance(gChild, 0);
 			}
 			else if (grandChildB==1){
-				current->setBalance(-1);
-				parent->setBalance(0);
-				gChild->setBalance(0);
+				links.setBalance(current, -1);
+				links.setBalance(parent, 0);
+				links.setBalance(gChild, 0);
 			}
 			else{
-				current->setBalance(0);
-				parent->setBalance(1);
-				gChild->setBalance(0);
+				links.setBalance(current, 0);
+				links.setBalance(parent, 1);
+				links.setBalance(gChild, 0);
 			}
 		}
 		//This is RR Imbalance
-		else if(parent->getBalance()==-2 && current->getBalance()==-1){
-			leftRotation(parent);
-			current->setBalance(0);
-			parent->setBalance(0); 
+		else if(links.balance(parent)==-2 && links.balance(current)==-1){
+			links.leftRotation(parent);
+			links.setBalance(current, 0);
+			links.setBalance(parent, 0); 
 		}
 
 		//This is RL Imbalance
-		else if(parent->getBalance()==2 && current->getBalance()==-1){
+		else if(links.balance(parent)==2 && links.balance(current)==-1){
 
 			//We need to save the grandcild balances to determine the balance updates
-			AVLNode<Key,Value> *gChild= current->getRight();
+			NodePtr gChild= links.right(current);
 			int grandChildB= 0; 
 			if (gChild!=nullptr){
-				grandChildB= gChild->getBalance(); 
+				grandChildB= links.balance(gChild); 
 			}
 
-			leftRotation(current);
-			rightRotation(parent);
+			links.leftRotation(current);
+			links.rightRotation(parent);
 
 			if (grandChildB==0){
-				current->setBalance(0);
-				parent->setBalance(0);
-				gChild->setBalance(0);
+				links.setBalance(current, 0);
+				links.setBalance(parent, 0);
+				links.setBalance(gChild, 0);
 			}
 			else if (grandChildB==1){
-				current->setBalance(0);
-				parent->setBalance(-1);
-				gChild->setBalance(0);
+				links.setBalance(current, 0);
+				links.setBalance(parent, -1);
+				links.setBalance(gChild, 0);
 			}
 			else{
-				current->setBalance(1);
-				parent->setBalance(0);
-				gChild->setBalance(0);
+				links.setBalance(current, 1);
+				links.setBalance(parent, 0);
+				links.setBalance(gChild, 0);
 			}
 		}
 
 		//This is LL Imbalance
 		else{
-			rightRotation(parent);
-			current->setBalance(0);
-			parent->setBalance(0); 
+			links.rightRotation(parent);
+			links.setBalance(current, 0);
+			links.setBalance(parent, 0); 
 		}
 		break;
 	}
@@ -310,314 +261,896 @@ void AVLTree<Key, Value>::balanceCheck(AVLNode< Key, Value> *current)
 
 
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::rightRotation(AVLNode< Key, Value> *current)
-{
-	//This is the right subtree of the middle node, we will use this later:
-	AVLNode<Key,Value> *tempRSubtree= current->getLeft()->getRight();
-	AVLNode<Key,Value> *newRoot= current->getLeft();
-
-	//Saving the current's parents before we modify it
-	AVLNode<Key,Value> *oldParent= current->getParent();
-
-
-	//Now we do the rotation
-	newRoot->setRight(current);
-	current->setLeft(tempRSubtree);
-
-	if (tempRSubtree!=nullptr){ //If there is a right subtree, we update its pointers
-		tempRSubtree->setParent(current);
-	}
-
-	//Now we update the parent pointers
-	newRoot->setParent(oldParent);
-	current->setParent(newRoot);
-
-	//Now we update the initial root's child pointers
-	if (oldParent!=nullptr){
-		if (oldParent->getLeft()==current){
-			oldParent->setLeft(newRoot);
-		}else{
-			oldParent->setRight(newRoot);
-		}
-	}else{
-		this->root_=newRoot;
-	}
-
-}
-
-
-
-template<class Key, class Value>
-void AVLTree<Key, Value>::leftRotation(AVLNode< Key, Value> *current)
-{
-	//This is the left subtree of the middle node, we will use this later:
-	AVLNode<Key,Value> *tempLSubtree= current->getRight()->getLeft();
-	AVLNode<Key,Value> *newRoot= current->getRight();
-
-	//Saving the current's parents before we modify it
-	AVLNode<Key,Value> *oldParent= current->getParent();
-
-
-	//Now we do the rotation
-	newRoot->setLeft(current);
-	current->setRight(tempLSubtree);
-
-	if (tempLSubtree!=nullptr){ //If there is a left subtree, we update its pointers
-		tempLSubtree->setParent(current);
-	}
-
-	//Now we update the parent pointers
-	newRoot->setParent(oldParent);
-	current->setParent(newRoot);
-
-	//Now we update the initial root's child pointers
-	if (oldParent!=nullptr){
-		if (oldParent->getLeft()==current){
-			oldParent->setLeft(newRoot);
-		}else{
-			oldParent->setRight(newRoot);
-		}
-	}else{
-		this->root_=newRoot;
-	}
-
-}
-
-
-
-
-/*
- * Recall: The writeup specifies that if a node has 2 children you
- * should swap with the predecessor and then remove.
- */
-template<class Key, class Value>
-void AVLTree<Key, Value>:: remove(const Key& key)
-{
-    // TODO
-		//Find the node to remove
-		AVLNode<Key, Value> *current=static_cast<AVLNode<Key,Value>*>(this->internalFind(key));
-
-		//CASE 1: node does not exist
-		if (current==nullptr){
-			return; 
-		}
-		int difference=0;
-
-		AVLNode <Key,Value> *rChild= current->getRight();
-		AVLNode<Key,Value> *lChild= current->getLeft();
-		AVLNode<Key,Value> *parent= current->getParent();
-
-		//CASE 2:There are two children
-		if (rChild!=nullptr &&lChild!=nullptr){
-			//Finding the successor to swap, this will ensure that we have 0 or 1 child to delete
-			AVLNode<Key, Value> *predecessor=static_cast<AVLNode<Key,Value>*>(this->predecessor(current));
-			
-			if (predecessor==nullptr){
-				return; 
-			}
-
-			nodeSwap(current, predecessor); 
-
-			//We set the links before deletion
-			parent= current->getParent(); 
-			rChild= current->getRight();
-			lChild=current->getLeft();
-		} 
-
-		//CASE 3: There is only one child
-		AVLNode<Key, Value>* child=nullptr; 
-		if (lChild!=nullptr){
-			child=lChild;
-		}else if (rChild!=nullptr){
-			child=rChild;
-		}
-
-		//Now we find the balance differences
-		if (parent!=nullptr){
-			if (parent->getLeft() ==current){
-				difference=-1;
-			}else{
-				difference=1;
-			}
-		}
-		
-		//Handle the root case
-		if (parent==nullptr){ 
-				this->root_=child; 
-				if (child!=nullptr){
-					child->setParent(nullptr); //A root node's parent is null
-				}
-		}else{//Handling all other cases
-				if (parent->getLeft()==current){
-					parent->setLeft(child); //This is if we came down from the left
-					if (child!=nullptr){
-						child->setParent(parent); //Reattaching the parent 
-					}
-				}else{
-					parent->setRight(child); //This is if we came down from the right
-					if (child!=nullptr){
-						child->setParent(parent); //Reattaching the parent
-					}
-				}
-
-		}
-		//we delete at the end
-		delete current; 
-
-		if (parent!=nullptr){
-			removeFix(parent, difference); 
-		}
-}
-
-template<class Key, class Value>
-void AVLTree<Key, Value>:: removeFix(AVLNode<Key,Value>* n, int difference)
+/**
+* n's subtree on one side got shorter by one, difference is the change to its
+* balance. Rotates where needed and keeps going up while the height of the
+* subtree keeps shrinking.
+*/
+template<class Links>
+void AVLAlgorithms<Links>::removeFix(Links& links, NodePtr n, int difference)
 {
 
 		//BASE CASE: if n is NULL, we return
 		if (n==nullptr){
 			return; 
 		}
+		links.countRemoveFix();
 
 	
 
 		//We compute the ndiff for the parent before any rotations because they alter the tree's structure
-		AVLNode<Key,Value> *newParent= n->getParent(); 
+		NodePtr newParent= links.parent(n); 
 
 
 		int ndifference=0; //This is the update needed on the balance factor of the parent
 		if (newParent!=nullptr){
-			if (newParent->getLeft()==n){ //If n is the right child 
+			if (links.left(newParent)==n){ //If n is the right child 
 				ndifference=-1;
 			}
-			else if (newParent->getRight()==n){ //If n is the left child 
+			else if (links.right(newParent)==n){ //If n is the left child 
 				ndifference=1; 
 			}
 		}
 
 		//NOW WE CHECK FOR ROTATIONS AND RECURSE:
-		int currBalance= n->getBalance()+ difference; 
+		int currBalance= links.balance(n)+ difference; 
 		//CASE 1:
 		if (currBalance==-1){ //We don't need further alteration
-			n->setBalance(-1);
+			links.setBalance(n, -1);
 			return; 
 		}
 
 		else if (currBalance==1){ //We don't need further alteration
-			n->setBalance(1);
+			links.setBalance(n, 1);
 			return; 
 		}
 
 
 		//CASE 2:
 		else if (currBalance==0){
-			n->setBalance(0);
-			removeFix(newParent, ndifference); //Now we have to check for parents and recurse up the tree
+			links.setBalance(n, 0);
+			removeFix(links, newParent, ndifference); //Now we have to check for parents and recurse up the tree
 
 		}
 
 		//CASE 3: Rotations needed 
 		else if (currBalance==-2){ 
 			//We find the taller child, which is the left
-			AVLNode <Key, Value> *rChild= n->getRight(); 
+			NodePtr rChild= links.right(n); 
 			if (rChild==nullptr){return;}
-			int rBalance= rChild->getBalance(); 
+			int rBalance= links.balance(rChild); 
 
 
 			if (rBalance==-1){//This is the LL Imbalance
-				leftRotation(n);
-				n->setBalance(0);
-				rChild->setBalance(0); 
-				removeFix( newParent, ndifference); //Keep updating
+				links.leftRotation(n);
+				links.setBalance(n, 0);
+				links.setBalance(rChild, 0); 
+				removeFix(links, newParent, ndifference); //Keep updating
 			}
 
 			else if (rBalance==0){
-				leftRotation(n);
-				n->setBalance(-1);
-				rChild->setBalance(1); 
+				links.leftRotation(n);
+				links.setBalance(n, -1);
+				links.setBalance(rChild, 1); 
 				//We are done!
 			}
 
 			else if (rBalance==1){
-				AVLNode <Key, Value> *grandLChild= rChild->getLeft(); 
+				NodePtr grandLChild= links.left(rChild); 
 				if (grandLChild==nullptr){
 					return; 
 				}
-				rightRotation(n->getRight());
-				leftRotation(n); 
+				links.rightRotation(links.right(n));
+				links.leftRotation(n); 
 
 				//Updating Balances:
-				int rBalance= grandLChild->getBalance();
+				int rBalance= links.balance(grandLChild);
 				if (rBalance==1 ){
-						n->setBalance(0); 
-						rChild->setBalance(-1);
-						grandLChild->setBalance(0); 
+						links.setBalance(n, 0); 
+						links.setBalance(rChild, -1);
+						links.setBalance(grandLChild, 0); 
 				}
 				else if (rBalance==-1){
-						n->setBalance(1); 
-						rChild->setBalance(0);
-						grandLChild->setBalance(0); 
+						links.setBalance(n, 1); 
+						links.setBalance(rChild, 0);
+						links.setBalance(grandLChild, 0); 
 				}
 				else if (rBalance==0){
-						n->setBalance(0); 
-						rChild->setBalance(0);
-						grandLChild->setBalance(0); 
+						links.setBalance(n, 0); 
+						links.setBalance(rChild, 0);
+						links.setBalance(grandLChild, 0); 
 				}
-				removeFix(newParent, ndifference); 
+				removeFix(links, newParent, ndifference); 
 			}
 		}
 		else if (currBalance==2){ 
 			//We find the taller child, which is the left
-			AVLNode <Key, Value> *lChild= n->getLeft(); 
+			NodePtr lChild= links.left(n); 
 			if (lChild==nullptr){
 				return; 
 			}
-			int rBalance= lChild->getBalance(); 
+			int rBalance= links.balance(lChild); 
 
 			if (rBalance==1){//This is the LL Imbalance
-				rightRotation(n); 
-				n->setBalance(0);
-				lChild->setBalance(0); 
-				removeFix( newParent, ndifference); //Keep updating
+				links.rightRotation(n); 
+				links.setBalance(n, 0);
+				links.setBalance(lChild, 0); 
+				removeFix(links, newParent, ndifference); //Keep updating
 			}
 
 			else if (rBalance==0){
-				rightRotation(n); 
-				n->setBalance(1);
-				lChild->setBalance(-1); 
+				links.rightRotation(n); 
+				links.setBalance(n, 1);
+				links.setBalance(lChild, -1); 
 				//We are done!
 			}
 
 			else if (rBalance==-1){
-				AVLNode <Key, Value> *grandRChild= lChild->getRight(); 
+				NodePtr grandRChild= links.right(lChild); 
 				if (grandRChild==nullptr){
 					return;
 				}
-				leftRotation(lChild);
-				rightRotation(n); 
+				links.leftRotation(lChild);
+				links.rightRotation(n); 
 
 				//Updating Balances:
-				int lLBalance= grandRChild->getBalance();
+				int lLBalance= links.balance(grandRChild);
 				if (lLBalance==1 ){
-						n->setBalance(-1); 
-						lChild->setBalance(0);
-						grandRChild->setBalance(0); 
+						links.setBalance(n, -1); 
+						links.setBalance(lChild, 0);
+						links.setBalance(grandRChild, 0); 
 				}
 				else if (lLBalance==-1 ){
-						n->setBalance(0); 
-						lChild->setBalance(1);
-						grandRChild->setBalance(0); 
+						links.setBalance(n, 0); 
+						links.setBalance(lChild, 1);
+						links.setBalance(grandRChild, 0); 
 				}
 				else if (lLBalance==0){
-						n->setBalance(0); 
-						lChild->setBalance(0);
-						grandRChild->setBalance(0); 
+						links.setBalance(n, 0); 
+						links.setBalance(lChild, 0);
+						links.setBalance(grandRChild, 0); 
 				}
-				removeFix(newParent, ndifference); 
+				removeFix(links, newParent, ndifference); 
 			}
 		}
 }
 
+/**
+* Takes current, which has at most one child, out of the tree; the child
+* takes its place. Returns current's parent (NULL for the root) and sets
+* difference to what that does to the parent's balance, for removeFix.
+*/
+template<class Links>
+typename AVLAlgorithms<Links>::NodePtr AVLAlgorithms<Links>::unlink(Links& links, NodePtr current, int& difference)
+{
+	NodePtr parent= links.parent(current);
+	NodePtr child= links.left(current);
+	if (child==nullptr){
+		child=links.right(current);
+	}
+
+	//Now we find the balance differences
+	difference=0;
+	if (parent!=nullptr){
+		if (links.left(parent)==current){
+			difference=-1;
+		}else{
+			difference=1;
+		}
+	}
+
+	//Handle the root case
+	if (parent==nullptr){
+		links.setRoot(child);
+	}
+	else if (difference==-1){
+		links.setLeft(parent, child); //This is if we came down from the left
+	}else{
+		links.setRight(parent, child); //This is if we came down from the right
+	}
+	if (child!=nullptr){
+		links.setParent(child, parent); //Reattaching the parent, a root node's parent is null
+	}
+	return parent;
+}
+
+
+
+template <class Key, class Value>
+class AVLTree : public BinarySearchTree<Key, Value>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+
+    explicit AVLTree(TreeMemoryResource* resource = NULL);
+    AVLTree(const AVLTree<Key, Value>& other);
+    AVLTree(AVLTree<Key, Value>&& other) noexcept;
+    AVLTree<Key, Value>& operator=(const AVLTree<Key, Value>& other);
+    AVLTree<Key, Value>& operator=(AVLTree<Key, Value>&& other) noexcept;
+    virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
+    iterator insert(iterator hint, const std::pair<const Key, Value> &new_item);
+    virtual void remove(const Key& key);  // TODO
+    virtual DetachedNodes detach_nodes();
+    virtual void compact();
+    virtual void rebalance();
+
+    // Relaxed balance: inserts leave their rebalancing for rebalance_pending(), see setRelaxedBalance()
+    void setRelaxedBalance(bool relaxed);
+    bool rebalance_pending(size_t budget = SIZE_MAX);
+    size_t pending_rebalances() const;
+
+    // Batches of keys in increasing order, each search resumes where the previous one ended
+    void find_sorted(const Key* keys, size_t count, iterator* results) const;
+    void find_sorted(const std::vector<Key>& keys, std::vector<iterator>& results) const;
+    void insert_sorted(const std::pair<const Key, Value>* items, size_t count);
+    void insert_sorted(const std::vector<std::pair<const Key, Value> >& items);
+
+    // The finger remembers the last inserted node so in-order appends skip the descent
+    void setFingerEnabled(bool enabled);
+protected:
+    virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
+
+    // AVLAlgorithms' view of this tree: AVLNode pointers, root_ and the rotations of bst.h
+    struct Links
+    {
+        typedef AVLNode<Key, Value>* NodePtr;
+
+        explicit Links(AVLTree<Key, Value>* tree) : tree_(tree) {}
+
+        NodePtr parent(NodePtr n) const { return n->getParent(); }
+        NodePtr left(NodePtr n) const { return n->getLeft(); }
+        NodePtr right(NodePtr n) const { return n->getRight(); }
+        void setParent(NodePtr n, NodePtr parent) { n->setParent(parent); }
+        void setLeft(NodePtr n, NodePtr left) { n->setLeft(left); }
+        void setRight(NodePtr n, NodePtr right) { n->setRight(right); }
+        void setRoot(NodePtr n) { tree_->root_ = n; }
+        int balance(NodePtr n) const { return n->getBalance(); }
+        void setBalance(NodePtr n, int balance) { n->setBalance(balance); }
+        void leftRotation(NodePtr n) { tree_->leftRotation(n); }
+        void rightRotation(NodePtr n) { tree_->rightRotation(n); }
+        void countRemoveFix()
+        {
+#ifdef BST_STATS
+            ++tree_->stats_.removeFixCalls;
+#endif
+        }
+
+        AVLTree<Key, Value>* tree_;
+    };
+
+    // Add helper functions here
+		void balanceCheck(AVLNode< Key, Value> *current);
+		// The rotations are shared with the other balanced trees in bst.h
+		using BinarySearchTree<Key, Value>::leftRotation;
+		using BinarySearchTree<Key, Value>::rightRotation;
+		void removeFix(AVLNode<Key,Value>* n, int difference);
+		AVLNode<Key, Value>* insertNode(const std::pair<const Key, Value> &new_item);
+		AVLNode<Key, Value>* insertBetween(AVLNode<Key, Value> *lo, AVLNode<Key, Value> *hi, const std::pair<const Key, Value> &new_item);
+		void resetFinger();
+		virtual Node<Key, Value>* newTreeNode(const Key& key, const Value& value, Node<Key, Value>* parent);
+		virtual void finishBuiltNode(Node<Key, Value>* n, int leftHeight, int rightHeight, bool deepestLevel);
+		virtual Node<Key, Value>* cloneNode(const Node<Key, Value>* source, Node<Key, Value>* parent);
+		AVLNode<Key, Value>* descendFrom(AVLNode<Key, Value> *from, const Key& key, AVLNode<Key, Value>*& last, AVLNode<Key, Value>*& next) const;
+		void settleInsert(AVLNode<Key, Value>* n);
+
+		// finger_ is the last inserted node and fingerNext_ its in-order successor (NULL if finger_ is
+		// the largest key). Rotations keep the in-order sequence, so only inserts and removes touch them.
+		AVLNode<Key, Value>* finger_;
+		AVLNode<Key, Value>* fingerNext_;
+		bool fingerEnabled_;
+
+		// In relaxed mode the inserted nodes whose balanceCheck has not run yet, oldest first
+		// starting at relaxedHead_. Their balance is kQueuedBalance until it runs.
+		static const int8_t kQueuedBalance= 3;
+		std::vector<AVLNode<Key, Value>*> relaxedQueue_;
+		size_t relaxedHead_;
+		bool relaxed_;
+};
+
+/**
+* Constructor, an empty tree with no finger.
+*/
+template<class Key, class Value>
+AVLTree<Key, Value>::AVLTree(TreeMemoryResource* resource) :
+    BinarySearchTree<Key, Value>(resource), finger_(nullptr), fingerNext_(nullptr), fingerEnabled_(true),
+    relaxedHead_(0), relaxed_(false)
+{
+
+}
+
+/**
+* Copy constructor, the copy has the same shape and balances as other. The
+* finger is not copied since it points into other's nodes. If other has
+* rebalancing pending, the copy is rebuilt balanced instead.
+*/
+template<class Key, class Value>
+AVLTree<Key, Value>::AVLTree(const AVLTree<Key, Value>& other) :
+    BinarySearchTree<Key, Value>(), finger_(nullptr), fingerNext_(nullptr), fingerEnabled_(other.fingerEnabled_),
+    relaxedHead_(0), relaxed_(other.relaxed_)
+{
+	//Copied here rather than by the base copy constructor, where cloneNode would not make AVLNodes yet
+	this->copyFrom(other);
+	if (other.pending_rebalances()!=0){
+		rebalance();
+	}
+}
+
+/**
+* Move constructor, O(1). The nodes move over and the finger with them.
+*/
+template<class Key, class Value>
+AVLTree<Key, Value>::AVLTree(AVLTree<Key, Value>&& other) noexcept :
+    BinarySearchTree<Key, Value>(std::move(other)), finger_(other.finger_), fingerNext_(other.fingerNext_),
+    fingerEnabled_(other.fingerEnabled_), relaxedQueue_(std::move(other.relaxedQueue_)),
+    relaxedHead_(other.relaxedHead_), relaxed_(other.relaxed_)
+{
+	other.resetFinger();
+	other.relaxedQueue_.clear();
+	other.relaxedHead_=0;
+}
+
+template<class Key, class Value>
+AVLTree<Key, Value>& AVLTree<Key, Value>::operator=(const AVLTree<Key, Value>& other)
+{
+	if (this!=&other){
+		BinarySearchTree<Key, Value>::operator=(other); //clear() resets our finger through detach_nodes()
+		fingerEnabled_=other.fingerEnabled_;
+		relaxed_=other.relaxed_;
+		if (other.pending_rebalances()!=0){
+			rebalance();
+		}
+	}
+	return *this;
+}
+
+template<class Key, class Value>
+AVLTree<Key, Value>& AVLTree<Key, Value>::operator=(AVLTree<Key, Value>&& other) noexcept
+{
+	if (this!=&other){
+		BinarySearchTree<Key, Value>::operator=(std::move(other));
+		finger_=other.finger_;
+		fingerNext_=other.fingerNext_;
+		fingerEnabled_=other.fingerEnabled_;
+		other.resetFinger();
+		relaxedQueue_.swap(other.relaxedQueue_);
+		relaxedHead_=other.relaxedHead_;
+		relaxed_=other.relaxed_;
+		other.relaxedQueue_.clear();
+		other.relaxedHead_=0;
+	}
+	return *this;
+}
+
+/**
+* Copies make AVLNodes with the balance of the node they copy.
+*/
+template<class Key, class Value>
+Node<Key, Value>* AVLTree<Key, Value>::cloneNode(const Node<Key, Value>* source, Node<Key, Value>* parent)
+{
+	AVLNode<Key, Value> *copy= this->template makeNode<AVLNode<Key, Value> >(source->getKey(), source->getValue(),
+		static_cast<AVLNode<Key,Value>*>(parent));
+	copy->setBalance(static_cast<const AVLNode<Key,Value>*>(source)->getBalance());
+	return copy;
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::resetFinger()
+{
+	finger_=nullptr;
+	fingerNext_=nullptr;
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::setFingerEnabled(bool enabled)
+{
+	fingerEnabled_=enabled;
+	resetFinger();
+}
+
+/**
+* Takes the nodes out like BinarySearchTree::detach_nodes(), the finger goes
+* with them. clear() and clear_incremental() come through here as well.
+*/
+template<class Key, class Value>
+DetachedNodes AVLTree<Key, Value>::detach_nodes()
+{
+	resetFinger();
+	relaxedQueue_.clear();
+	relaxedHead_=0;
+	return BinarySearchTree<Key, Value>::detach_nodes();
+}
+
+/**
+* Relays out the nodes like BinarySearchTree::compact(), the finger pointed
+* at an old node so it is dropped. Pending rebalancing is done first.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::compact()
+{
+	rebalance_pending();
+	resetFinger();
+	BinarySearchTree<Key, Value>::compact();
+}
+
+/**
+* Rebuilds the tree balanced like BinarySearchTree::rebalance(), which sets
+* every balance, so nothing is pending afterwards.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::rebalance()
+{
+	relaxedQueue_.clear();
+	relaxedHead_=0;
+	BinarySearchTree<Key, Value>::rebalance();
+}
+
+/**
+* Relaxed balance, for bursts of inserts that should cost as little as
+* possible right away. An insert then only searches and links the new node,
+* and queues the balanceCheck it would have run; rebalance_pending() runs the
+* queued ones later, oldest first, and turning the mode off runs them all.
+* Searches stay correct the whole time, the tree just gets deeper until the
+* work is done. The nodes of later inserts can only hang below those of
+* earlier ones, so running each balanceCheck in insert order, as if its node
+* were a new leaf and every node still queued were not there yet, leaves a
+* valid AVL tree at every step.
+*
+* Queued nodes only ever hang below settled ones, so a remove whose node (or
+* the predecessor it swaps with) is settled rebalances as usual and leaves
+* the queue alone. Removing a key that is still queued first settles the
+* queue in insert order up to it, so it costs one balanceCheck for every
+* insert queued before it: right after a burst, removing one of its last
+* keys does nearly all of the burst's deferred work. Neither this nor
+* rebalance_pending() may run at the same time as other operations on the
+* tree; call it between them, e.g. when a burst ends.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::setRelaxedBalance(bool relaxed)
+{
+	relaxed_=relaxed;
+	if (!relaxed){
+		rebalance_pending();
+	}
+}
+
+/**
+* Runs the rebalancing of up to budget queued inserts, each O(log n) at worst
+* and O(1) amortized. Returns true once nothing is pending.
+*/
+template<class Key, class Value>
+bool AVLTree<Key, Value>::rebalance_pending(size_t budget)
+{
+	while (budget>0 && relaxedHead_<relaxedQueue_.size()){
+		AVLNode<Key, Value> *n= relaxedQueue_[relaxedHead_++];
+		n->setBalance(0);
+		balanceCheck(n);
+		--budget;
+	}
+	if (relaxedHead_==relaxedQueue_.size()){
+		relaxedQueue_.clear();
+		relaxedHead_=0;
+		return true;
+	}
+	return false;
+}
+
+/**
+* The number of inserts whose rebalancing is still queued.
+*/
+template<class Key, class Value>
+size_t AVLTree<Key, Value>::pending_rebalances() const
+{
+	return relaxedQueue_.size()-relaxedHead_;
+}
+
+/**
+* The last step of every insert of a new node: balanceCheck now, or later in
+* relaxed mode.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::settleInsert(AVLNode<Key, Value>* n)
+{
+	if (relaxed_){
+		relaxedQueue_.push_back(n);
+		n->setBalance(kQueuedBalance);
+	}else{
+		balanceCheck(n);
+	}
+}
+
+/**
+* load() builds the tree out of AVLNodes.
+*/
+template<class Key, class Value>
+Node<Key, Value>* AVLTree<Key, Value>::newTreeNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+	return this->template makeNode<AVLNode<Key, Value> >(key, value, static_cast<AVLNode<Key,Value>*>(parent));
+}
+
+/**
+* Once load() knows both subtree heights, the balance is just their difference.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::finishBuiltNode(Node<Key, Value>* n, int leftHeight, int rightHeight, bool)
+{
+	static_cast<AVLNode<Key,Value>*>(n)->setBalance(leftHeight-rightHeight);
+}
+
+/**
+* Attaches a new node for new_item between the in-order neighbours lo and hi
+* (either may be NULL at the ends) without searching from the root. When lo has
+* no right child the node goes there, otherwise hi is the leftmost node of lo's
+* right subtree and has a free left child. The new node becomes the finger.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::insertBetween(AVLNode<Key, Value> *lo, AVLNode<Key, Value> *hi, const std::pair<const Key, Value> &new_item)
+{
+	AVLNode<Key, Value> *toInsert;
+	if (lo!=nullptr && lo->getRight()==nullptr){
+		toInsert= this->template makeNode<AVLNode<Key, Value> >(new_item.first, new_item.second, lo);
+		lo->setRight(toInsert);
+	}else{
+		toInsert= this->template makeNode<AVLNode<Key, Value> >(new_item.first, new_item.second, hi);
+		hi->setLeft(toInsert);
+	}
+
+	if (fingerEnabled_){
+		finger_=toInsert;
+		fingerNext_=hi;
+	}
+	settleInsert(toInsert);
+	return toInsert;
+}
+
+/*
+ * Inserts new_item next to hint if that is where it belongs, which costs
+ * O(1) plus the rebalancing instead of a search from the root. The key may
+ * go right before or right after hint. With the end() hint the key must be
+ * larger than every key in the tree. If the hint is wrong this is a normal
+ * insert. Returns an iterator to the inserted (or updated) item.
+ */
+template<class Key, class Value>
+typename AVLTree<Key, Value>::iterator
+AVLTree<Key, Value>::insert(iterator hint, const std::pair<const Key, Value> &new_item)
+{
+	AVLNode<Key, Value> *h= static_cast<AVLNode<Key,Value>*>(this->iteratorNode(hint));
+	const Key& k=new_item.first;
+
+	if (h==nullptr){
+		//end(): only an append fits, and the finger knows whether it sits on the largest key
+		if (finger_==nullptr || fingerNext_!=nullptr || !(finger_->getKey()<k)){
+			return this->makeIterator(insertNode(new_item));
+		}
+		BST_COUNT(operations, 1);
+		return this->makeIterator(insertBetween(finger_, nullptr, new_item));
+	}
+
+	BST_COUNT(operations, 1);
+	if (k<h->getKey()){
+		AVLNode<Key, Value> *pred= static_cast<AVLNode<Key,Value>*>(this->predecessor(h));
+		if (pred==nullptr || pred->getKey()<k){
+			return this->makeIterator(insertBetween(pred, h, new_item));
+		}
+	}
+	else if (h->getKey()<k){
+		AVLNode<Key, Value> *succ= static_cast<AVLNode<Key,Value>*>(this->successor(h));
+		if (succ==nullptr || k<succ->getKey()){
+			return this->makeIterator(insertBetween(h, succ, new_item));
+		}
+	}
+	else{
+		h->setValue(new_item.second);
+		return hint;
+	}
+	//Wrong hint, the operation was already counted so we go straight to insertNode
+	return this->makeIterator(insertNode(new_item));
+}
+
+/**
+* Searches for key starting near from instead of at the root. We climb from
+* "from" until we know the range key is in and descend from the lowest node
+* whose subtree covers it. key must not be smaller than the keys in from's subtree's range,
+* which is the case for the node the previous, smaller key's search ended at.
+* A NULL from searches from the root. Returns the node with key or NULL; last
+* is the last node visited (the parent for an insert) and next the smallest
+* key seen that is larger than key (its successor, NULL if none).
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::descendFrom(AVLNode<Key, Value> *from, const Key& key, AVLNode<Key, Value>*& last, AVLNode<Key, Value>*& next) const
+{
+	next=nullptr;
+	last=nullptr;
+	AVLNode<Key, Value> *temp= static_cast<AVLNode<Key,Value>*>(this->root_);
+	if (from!=nullptr){
+		//Every key in a left child's subtree is below the parent, so going up a left
+		//edge is where a range ends. Going up a right edge keeps the same range, so we
+		//only move the starting point when we pass a parent whose key is <= key
+		temp=from;
+		AVLNode<Key, Value> *up= from;
+		while (up->getParent()!=nullptr){
+			AVLNode<Key, Value> *parent= up->getParent();
+			BST_COUNT(nodesVisited, 1);
+			if (parent->getLeft()==up){
+				BST_COUNT(comparisons, 1);
+				if (key<parent->getKey()){
+					next=parent;
+					break;
+				}
+				temp=parent;
+			}
+			up=parent;
+		}
+	}
+
+	while (temp!=nullptr){
+		last=temp;
+		BST_COUNT(nodesVisited, 1);
+		BST_COUNT(comparisons, 1);
+		if (key<temp->getKey()){
+			next=temp;
+			temp=temp->getLeft();
+		}
+		else if (BST_COUNT(comparisons, 1), temp->getKey()<key){
+			temp=temp->getRight();
+		}
+		else{
+			return temp;
+		}
+	}
+	return nullptr;
+}
+
+/**
+* Looks up count keys given in increasing order and stores an iterator for
+* each (end() if missing) in results. Neighbouring keys share most of their
+* path, so every search starts from where the previous one ended and only
+* climbs as far as needed. For k keys in a tree of n this is O(k log(n/k))
+* instead of O(k log n). A key smaller than the one before it is still found,
+* its search just starts over from the root.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::find_sorted(const Key* keys, size_t count, iterator* results) const
+{
+	BST_COUNT(operations, count);
+	AVLNode<Key, Value> *from= nullptr;
+	AVLNode<Key, Value> *last;
+	AVLNode<Key, Value> *next;
+	for (size_t i=0; i<count; ++i){
+		if (i>0 && keys[i]<keys[i-1]){
+			from=nullptr;
+		}
+		AVLNode<Key, Value> *found= descendFrom(from, keys[i], last, next);
+		results[i]=this->makeIterator(found);
+		from= (found!=nullptr) ? found : last;
+	}
+}
+
+/**
+* Vector version of find_sorted, results is resized to match keys.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::find_sorted(const std::vector<Key>& keys, std::vector<iterator>& results) const
+{
+	results.resize(keys.size());
+	if (!keys.empty()){
+		find_sorted(&keys[0], keys.size(), &results[0]);
+	}
+}
+
+/**
+* Inserts count items given in increasing key order, like insert() on each
+* (existing keys get the new value) but every search resumes at the node the
+* previous item ended up in. Rotations move that node around but it keeps its
+* parent links, so climbing from it stays correct. Out of order items are
+* inserted correctly too, starting from the root. The last item becomes the finger.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::insert_sorted(const std::pair<const Key, Value>* items, size_t count)
+{
+	BST_COUNT(operations, count);
+	AVLNode<Key, Value> *from= nullptr;
+	AVLNode<Key, Value> *last;
+	AVLNode<Key, Value> *next;
+	for (size_t i=0; i<count; ++i){
+		const Key& keyNew=items[i].first;
+		if (i>0 && keyNew<items[i-1].first){
+			from=nullptr;
+		}
+		AVLNode<Key, Value> *found= descendFrom(from, keyNew, last, next);
+		if (found!=nullptr){
+			found->setValue(items[i].second);
+			from=found;
+			continue;
+		}
+
+		AVLNode<Key, Value> *toInsert= this->template makeNode<AVLNode<Key, Value> >(keyNew, items[i].second, last);
+		if (last==nullptr){
+			this->root_=toInsert;
+		}
+		else if (keyNew<last->getKey()){
+			last->setLeft(toInsert);
+		}else{
+			last->setRight(toInsert);
+		}
+		if (fingerEnabled_){
+			finger_=toInsert;
+			fingerNext_=next;
+		}
+		settleInsert(toInsert);
+		from=toInsert;
+	}
+}
+
+/**
+* Vector version of insert_sorted.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::insert_sorted(const std::vector<std::pair<const Key, Value> >& items)
+{
+	if (!items.empty()){
+		insert_sorted(&items[0], items.size());
+	}
+}
+
+/*
+ * Recall: If key is already in the tree, you should 
+ * overwrite the current value with the updated value.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+{
+	BST_COUNT(operations, 1);
+	insertNode(new_item);
+}
+
+/**
+* Does the work of insert() and returns the node holding the key.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::insertNode (const std::pair<const Key, Value> &new_item)
+{
+  // TODO
+	if (this->root_==nullptr){
+		this->root_= this->template makeNode<AVLNode<Key,Value> >(new_item.first, new_item.second, nullptr);
+		if (fingerEnabled_){
+			finger_=static_cast<AVLNode<Key,Value>*>(this->root_);
+			fingerNext_=nullptr;
+		}
+		return static_cast<AVLNode<Key,Value>*>(this->root_); 
+	}
+
+	//CASE 0: The key belongs right after the last inserted one, as with increasing keys, so no search is needed
+	if (finger_!=nullptr){
+		BST_COUNT(comparisons, 1);
+		if (finger_->getKey()<new_item.first && (fingerNext_==nullptr || new_item.first<fingerNext_->getKey())){
+			return insertBetween(finger_, fingerNext_, new_item);
+		}
+	}
+
+	//CASE 1: If KEY is already in the tree, we will find it and update it's value
+		Node<Key, Value> *parentNode= nullptr; //the parent of the new node
+		Node<Key, Value> *nextNode= nullptr; //the successor of the new node
+		AVLNode<Key,Value> *found= static_cast<AVLNode<Key,Value>*>(this->findInsertPoint(new_item.first, parentNode, nextNode)); 
+		if (found!=nullptr){ //If KEY found
+			found->setValue(new_item.second); //Updating the VALUE
+			return found;
+		}
+
+		//CASE 2: If the KEY doesn't already exist we insert normally
+
+		AVLNode<Key, Value> *parent= static_cast<AVLNode<Key,Value>*>(parentNode);
+		AVLNode<Key, Value> *next= static_cast<AVLNode<Key,Value>*>(nextNode);
+
+		const Key& keyNew=new_item.first; //This is our new KEY to insert
+		const Value& valueNew=new_item.second; //This is our new VALUE to insert
+
+		//This is where we reached the leaf node to insert, we found where we are going to insert
+		AVLNode<Key, Value> *toInsert= this->template makeNode<AVLNode<Key, Value> >(keyNew, valueNew, parent); 
+		toInsert->setBalance(0);
+
+		//Checking whether we should insert it to the left or right of the parent
+		if(keyNew<parent->getKey()){
+				parent->setLeft(toInsert); 
+		}else{
+			parent->setRight(toInsert);
+		}
+
+		//The new node becomes the finger
+		if (fingerEnabled_){
+			finger_=toInsert;
+			fingerNext_=next;
+		}
+
+		//NOW CHECKING BALANCE
+		settleInsert(toInsert);
+		return toInsert;
+}
+
+
+
+/**
+* Settles the balances above a node that was just linked in as a leaf, with
+* AVLAlgorithms::balanceCheck.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::balanceCheck(AVLNode< Key, Value> *current)
+{
+	Links links(this);
+	AVLAlgorithms<Links>::balanceCheck(links, current);
+}
+
+/*
+ * Recall: The writeup specifies that if a node has 2 children you
+ * should swap with the predecessor and then remove.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>:: remove(const Key& key)
+{
+    // TODO
+		BST_COUNT(operations, 1);
+		//Find the node to remove
+		AVLNode<Key, Value> *current=static_cast<AVLNode<Key,Value>*>(this->internalFind(key));
+
+		//CASE 1: node does not exist
+		if (current==nullptr){
+			return; 
+		}
+		//The fixes below need correct balances from the node that leaves the tree up to the root.
+		//In relaxed mode it may still be queued, then we settle the queue in order until it is not
+		while (relaxedHead_<relaxedQueue_.size()){
+			AVLNode<Key, Value> *leaving= current;
+			if (current->getLeft()!=nullptr && current->getRight()!=nullptr){
+				leaving=static_cast<AVLNode<Key,Value>*>(this->predecessor(current));
+			}
+			if (leaving->getBalance()!=kQueuedBalance){
+				break;
+			}
+			rebalance_pending(1);
+		}
+		int difference=0;
+
+		//CASE 2:There are two children
+		if (current->getLeft()!=nullptr && current->getRight()!=nullptr){
+			//Finding the successor to swap, this will ensure that we have 0 or 1 child to delete
+			AVLNode<Key, Value> *predecessor=static_cast<AVLNode<Key,Value>*>(this->predecessor(current));
+			
+			if (predecessor==nullptr){
+				return; 
+			}
+
+			nodeSwap(current, predecessor); 
+		} 
+
+		//CASE 3: There is only one child (or none), it takes current's place
+		Links links(this);
+		AVLNode<Key,Value> *parent= AVLAlgorithms<Links>::unlink(links, current, difference);
+
+		//The finger must not point at the removed node, and if its successor goes the bound is stale
+		if (current==finger_ || current==fingerNext_){
+			resetFinger();
+		}
+
+		//we delete at the end
+		this->freeNode(current); 
+
+		if (parent!=nullptr){
+#ifdef BST_STATS
+			uint64_t callsBefore= this->stats_.removeFixCalls;
+			removeFix(parent, difference); 
+			this->stats_.maxRemoveFixDepth= std::max(this->stats_.maxRemoveFixDepth, this->stats_.removeFixCalls-callsBefore);
+#else
+			removeFix(parent, difference); 
+#endif
+		}
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>:: removeFix(AVLNode<Key,Value>* n, int difference)
+{
+	Links links(this);
+	AVLAlgorithms<Links>::removeFix(links, n, difference);
+}
+
 template<class Key, class Value>
 void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
 {
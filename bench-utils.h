@@ -0,0 +1,188 @@
+#ifndef BENCH_UTILS_H
+#define BENCH_UTILS_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/**
+* Small helpers shared by the *-bench drivers. Every workload is generated
+* from a fixed seed so runs can be compared against each other.
+*/
+
+/**
+* A wall clock stopwatch with nanosecond resolution.
+*/
+class BenchTimer
+{
+public:
+    BenchTimer() : start_(std::chrono::steady_clock::now()) {}
+    void restart() { start_ = std::chrono::steady_clock::now(); }
+    uint64_t elapsedNs() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_).count();
+    }
+    double elapsedSec() const { return elapsedNs() / 1e9; }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+/**
+* SplitMix64, a tiny and fast generator. Unlike std::rand() it gives the
+* same sequence on every platform.
+*/
+class BenchRandom
+{
+public:
+    explicit BenchRandom(uint64_t seed) : state_(seed) {}
+    uint64_t next()
+    {
+        uint64_t z = (state_ += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+    // Uniform in [0, n)
+    uint64_t below(uint64_t n) { return next() % n; }
+    // Uniform in [0, 1)
+    double unit() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+private:
+    uint64_t state_;
+};
+
+/**
+* Returns the keys 0..n-1 in a reproducible random order.
+*/
+inline std::vector<uint64_t> shuffledKeys(uint64_t n, uint64_t seed)
+{
+    std::vector<uint64_t> keys(n);
+    for(uint64_t i = 0; i < n; ++i) keys[i] = i;
+    BenchRandom rng(seed);
+    for(uint64_t i = n; i > 1; --i) {
+        std::swap(keys[i - 1], keys[rng.below(i)]);
+    }
+    return keys;
+}
+
+/**
+* Draws ranks 1..n from a Zipf distribution with exponent s, so rank 1 is the
+* most popular. Uses rejection-inversion sampling (Hormann and Derflinger),
+* which needs O(1) memory even for very large n.
+*/
+class ZipfGenerator
+{
+public:
+    ZipfGenerator(uint64_t n, double exponent) : n_(n), exponent_(exponent)
+    {
+        hIntegralX1_ = hIntegral(1.5) - 1.0;
+        hIntegralN_ = hIntegral(n + 0.5);
+        s_ = 2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0));
+    }
+
+    uint64_t next(BenchRandom& rng)
+    {
+        while(true) {
+            double u = hIntegralN_ + rng.unit() * (hIntegralX1_ - hIntegralN_);
+            double x = hIntegralInverse(u);
+            double k = std::floor(x + 0.5);
+            if(k < 1) k = 1;
+            else if(k > n_) k = static_cast<double>(n_);
+            if(k - x <= s_ || u >= hIntegral(k + 0.5) - h(k)) {
+                return static_cast<uint64_t>(k);
+            }
+        }
+    }
+
+private:
+    double h(double x) const { return std::exp(-exponent_ * std::log(x)); }
+    double hIntegral(double x) const
+    {
+        double logX = std::log(x);
+        return helper2((1.0 - exponent_) * logX) * logX;
+    }
+    double hIntegralInverse(double x) const
+    {
+        double t = x * (1.0 - exponent_);
+        if(t < -1.0) t = -1.0;
+        return std::exp(helper1(t) * x);
+    }
+    // log1p(x)/x and expm1(x)/x with care around 0
+    static double helper1(double x)
+    {
+        if(std::fabs(x) > 1e-8) return std::log1p(x) / x;
+        return 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+    static double helper2(double x)
+    {
+        if(std::fabs(x) > 1e-8) return std::expm1(x) / x;
+        return 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+    }
+
+    uint64_t n_;
+    double exponent_;
+    double hIntegralX1_;
+    double hIntegralN_;
+    double s_;
+};
+
+/**
+* Returns the p-th percentile (0 <= p <= 100) of samples, which must be sorted.
+*/
+inline uint64_t percentile(const std::vector<uint64_t>& sorted, double p)
+{
+    if(sorted.empty()) return 0;
+    size_t idx = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+/**
+* Runs f() in a forked child and returns the double it computed. Every run
+* then starts from the same fresh heap: a tree built after another one was
+* freed gets its nodes from recycled, scattered chunks and runs measurably
+* slower, which would otherwise depend on the order of the runs.
+*/
+template<typename F>
+double runIsolated(F f)
+{
+    int fds[2];
+    if(pipe(fds) != 0) return f();
+    pid_t pid = fork();
+    if(pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return f();
+    }
+    if(pid == 0) {
+        close(fds[0]);
+        double result = f();
+        ssize_t ignored = write(fds[1], &result, sizeof(result));
+        (void)ignored;
+        _exit(0);
+    }
+    close(fds[1]);
+    double result = 0;
+    ssize_t got = read(fds[0], &result, sizeof(result));
+    close(fds[0]);
+    waitpid(pid, NULL, 0);
+    return got == sizeof(result) ? result : 0;
+}
+
+/**
+* Keeps the compiler from optimizing away a benchmarked result.
+*/
+template<typename T>
+inline void benchKeep(const T& value)
+{
+    static volatile uint64_t sink;
+    sink = sink + static_cast<uint64_t>(value);
+}
+
+#endif
@@ -0,0 +1,289 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include "bst.h"
+#include "avlbst.h"
+#include "bench-utils.h"
+
+using namespace std;
+
+// Benchmark suite comparing BinarySearchTree, AVLTree and std::map.
+// Every workload runs at sizes 1K, 10K, ... up to maxSize and prints one CSV
+// row per (workload, structure, size), so results can be diffed across releases.
+//
+// Usage: ./bench [maxSize] [workload]
+//   maxSize   largest size to run, default 10000000
+//   workload  only run this workload (sequential, random, reverse, zipfian,
+//             mixed or scan), default all of them
+
+/*
+  ---------------------------------------------------------------
+  Heap accounting. Live bytes are what malloc actually hands out
+  (malloc_usable_size), so rounding slack counts but the allocator's
+  own chunk headers do not.
+  ---------------------------------------------------------------
+*/
+static uint64_t gLiveBytes = 0;
+
+// Kept out of line, otherwise GCC inlines the free() into delete expressions
+// and warns about freeing memory that came from new
+__attribute__((noinline)) void* operator new(size_t size)
+{
+    void* p = malloc(size == 0 ? 1 : size);
+    if(p == NULL) throw std::bad_alloc();
+    gLiveBytes += malloc_usable_size(p);
+    return p;
+}
+
+__attribute__((noinline)) void operator delete(void* ptr) noexcept
+{
+    if(ptr == NULL) return;
+    gLiveBytes -= malloc_usable_size(ptr);
+    free(ptr);
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete[](void* ptr) noexcept { operator delete(ptr); }
+
+/*
+  ---------------------------------------------------------------
+  Structures under test. std::map is wrapped so it takes the same
+  calls as our trees (insert overwrites, remove erases).
+  ---------------------------------------------------------------
+*/
+class StdMap
+{
+public:
+    typedef map<uint64_t, uint64_t>::iterator iterator;
+    void insert(const pair<const uint64_t, uint64_t>& kv) { map_[kv.first] = kv.second; }
+    void remove(const uint64_t& key) { map_.erase(key); }
+    iterator find(const uint64_t& key) { return map_.find(key); }
+    iterator end() { return map_.end(); }
+
+private:
+    map<uint64_t, uint64_t> map_;
+};
+
+typedef BinarySearchTree<uint64_t, uint64_t> BST;
+typedef AVLTree<uint64_t, uint64_t> AVL;
+
+/*
+  ---------------------------------------------------------------
+  Workloads
+  ---------------------------------------------------------------
+*/
+enum Workload { SEQUENTIAL, RANDOM, REVERSE, ZIPFIAN, MIXED, SCAN, NUM_WORKLOADS };
+
+static const char* workloadNames[NUM_WORKLOADS] = {
+    "sequential", "random", "reverse", "zipfian", "mixed", "scan"
+};
+
+static const uint64_t kScanLength = 100;
+// At most this many latency samples are kept per run
+static const uint64_t kMaxSamples = 1000000;
+// The unbalanced tree turns into a linked list on sorted input, which is
+// quadratic, so it only runs the sorted workloads up to this size
+static const uint64_t kMaxDegenerateSize = 20000;
+
+struct Result
+{
+    uint64_t ops;
+    double seconds;
+    vector<uint64_t> samples;
+    double bytesPerEntry;
+};
+
+/**
+* Times op(i) for i in [0, ops). Every stride-th op is timed on its own
+* to get the latency distribution, keeping at most kMaxSamples samples.
+*/
+template<typename Op>
+void timeOps(uint64_t ops, Op& op, Result& result)
+{
+    uint64_t stride = max<uint64_t>(1, (ops + kMaxSamples - 1) / kMaxSamples);
+    result.ops = ops;
+    result.samples.clear();
+
+    BenchTimer total;
+    for(uint64_t i = 0; i < ops; ++i) {
+        if(i % stride == 0) {
+            BenchTimer timer;
+            op(i);
+            result.samples.push_back(timer.elapsedNs());
+        }
+        else {
+            op(i);
+        }
+    }
+    result.seconds = total.elapsedSec();
+    sort(result.samples.begin(), result.samples.end());
+}
+
+// The ops below are plain functors since the suite sticks to C++11
+template<typename Tree>
+struct InsertOp
+{
+    Tree& tree;
+    const vector<uint64_t>& keys;
+    void operator()(uint64_t i) { tree.insert(make_pair(keys[i], keys[i])); }
+};
+
+template<typename Tree>
+struct FindOp
+{
+    Tree& tree;
+    const vector<uint64_t>& keys;
+    uint64_t found;
+    void operator()(uint64_t i) { found += (tree.find(keys[i]) != tree.end()); }
+};
+
+template<typename Tree>
+struct MixedOp
+{
+    Tree& tree;
+    const vector<uint64_t>& keys;
+    const vector<uint8_t>& kinds;
+    uint64_t found;
+    void operator()(uint64_t i)
+    {
+        // 50% finds, 25% inserts and 25% removes
+        if(kinds[i] < 2) found += (tree.find(keys[i]) != tree.end());
+        else if(kinds[i] == 2) tree.insert(make_pair(keys[i], i));
+        else tree.remove(keys[i]);
+    }
+};
+
+template<typename Tree>
+struct ScanOp
+{
+    Tree& tree;
+    const vector<uint64_t>& keys;
+    uint64_t sum;
+    void operator()(uint64_t i)
+    {
+        typename Tree::iterator it = tree.find(keys[i]);
+        for(uint64_t j = 0; j < kScanLength && it != tree.end(); ++j, ++it) {
+            sum += it->second;
+        }
+    }
+};
+
+template<typename Tree>
+void fill(Tree& tree, const vector<uint64_t>& keys)
+{
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+}
+
+/**
+* Runs one workload of the given size against a fresh Tree.
+*/
+template<typename Tree>
+void runWorkload(Workload workload, uint64_t n, Result& result)
+{
+    // Reserve the sample buffer up front so it is not counted against the tree
+    result.samples.reserve(kMaxSamples);
+    uint64_t before = gLiveBytes;
+    Tree* tree = new Tree();
+
+    if(workload == SEQUENTIAL || workload == RANDOM || workload == REVERSE) {
+        // Measure the build itself
+        vector<uint64_t> keys;
+        if(workload == RANDOM) {
+            keys = shuffledKeys(n, 11);
+        }
+        else {
+            keys.resize(n);
+            for(uint64_t i = 0; i < n; ++i) {
+                keys[i] = (workload == SEQUENTIAL) ? i : n - 1 - i;
+            }
+        }
+        uint64_t keysBytes = gLiveBytes - before;
+        InsertOp<Tree> op = { *tree, keys };
+        timeOps(n, op, result);
+        result.bytesPerEntry = double(gLiveBytes - before - keysBytes) / n;
+    }
+    else {
+        fill(*tree, shuffledKeys(n, 11));
+        result.bytesPerEntry = double(gLiveBytes - before) / n;
+
+        BenchRandom rng(12);
+        vector<uint64_t> keys(workload == SCAN ? max<uint64_t>(1, n / kScanLength) : n);
+        if(workload == ZIPFIAN) {
+            // Hot ranks land on scattered keys, not just the smallest ones
+            vector<uint64_t> ranked = shuffledKeys(n, 13);
+            ZipfGenerator zipf(n, 0.99);
+            for(size_t i = 0; i < keys.size(); ++i) {
+                keys[i] = ranked[zipf.next(rng) - 1];
+            }
+            FindOp<Tree> op = { *tree, keys, 0 };
+            timeOps(keys.size(), op, result);
+            benchKeep(op.found);
+        }
+        else if(workload == MIXED) {
+            // Half of the keys written and looked up fall outside the initial set
+            vector<uint8_t> kinds(n);
+            for(size_t i = 0; i < keys.size(); ++i) {
+                keys[i] = rng.below(2 * n);
+                kinds[i] = rng.below(4);
+            }
+            MixedOp<Tree> op = { *tree, keys, kinds, 0 };
+            timeOps(keys.size(), op, result);
+            benchKeep(op.found);
+        }
+        else {
+            for(size_t i = 0; i < keys.size(); ++i) {
+                keys[i] = rng.below(n);
+            }
+            ScanOp<Tree> op = { *tree, keys, 0 };
+            timeOps(keys.size(), op, result);
+            benchKeep(op.sum);
+        }
+    }
+    delete tree;
+}
+
+void report(Workload workload, const char* structure, uint64_t n, const Result& result)
+{
+    cout << workloadNames[workload] << "," << structure << "," << n << ","
+         << result.ops << "," << uint64_t(result.ops / result.seconds) << ","
+         << percentile(result.samples, 50) << "," << percentile(result.samples, 90) << ","
+         << percentile(result.samples, 99) << "," << percentile(result.samples, 99.9) << ","
+         << result.samples.back() << "," << result.bytesPerEntry << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t maxSize = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+    string only = argc > 2 ? argv[2] : "";
+
+    cout << "workload,structure,size,ops,ops_per_sec,p50_ns,p90_ns,p99_ns,p999_ns,max_ns,bytes_per_entry" << endl;
+    for(int w = 0; w < NUM_WORKLOADS; ++w) {
+        Workload workload = static_cast<Workload>(w);
+        if(!only.empty() && only != workloadNames[w]) continue;
+
+        for(uint64_t n = 1000; n <= maxSize; n *= 10) {
+            Result result;
+            bool sorted = (workload == SEQUENTIAL || workload == REVERSE);
+            if(!sorted || n <= kMaxDegenerateSize) {
+                runWorkload<BST>(workload, n, result);
+                report(workload, "BinarySearchTree", n, result);
+            }
+            else {
+                cerr << "skipping BinarySearchTree " << workloadNames[w] << " at " << n
+                     << " (quadratic on sorted input)" << endl;
+            }
+            runWorkload<AVL>(workload, n, result);
+            report(workload, "AVLTree", n, result);
+            runWorkload<StdMap>(workload, n, result);
+            report(workload, "std::map", n, result);
+        }
+    }
+    return 0;
+}
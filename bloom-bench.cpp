@@ -0,0 +1,88 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include "avlbst.h"
+#include "bench-utils.h"
+
+using namespace std;
+
+// Random point lookups on an AVLTree of random keys where most lookups miss,
+// without a Bloom filter and with one at several false positive rates (see
+// setBloomFilter). Reports ns per lookup, ns per insert while filling the
+// tree, the filter's bytes per key and the false positive rate it reports.
+// Usage: ./bloom-bench [numKeys] [numLookups] [missPercent]
+
+enum Measure { INSERT, FIND, BYTES_PER_KEY, RATE };
+
+struct RunBloom
+{
+    RunBloom(double r, Measure m, uint64_t n, uint64_t l, uint64_t p) :
+        rate(r), measure(m), numKeys(n), numLookups(l), missPercent(p) {}
+
+    // Returns ns per insert or per lookup, the filter's bytes per key or its estimated rate
+    double operator()() const
+    {
+        BenchRandom rng(1);
+        vector<uint64_t> keys(numKeys);
+        for(uint64_t i = 0; i < numKeys; ++i) {
+            keys[i] = rng.next();
+        }
+        AVLTree<uint64_t, uint64_t> tree;
+        tree.setBloomFilter(rate);
+        BenchTimer timer;
+        for(uint64_t i = 0; i < numKeys; ++i) {
+            tree.insert(make_pair(keys[i], i));
+        }
+        double insertNs = timer.elapsedNs();
+        if(measure == INSERT) {
+            return insertNs / numKeys;
+        }
+        if(measure == BYTES_PER_KEY) {
+            return double(tree.bloom_filter_stats().bytes) / numKeys;
+        }
+        if(measure == RATE) {
+            return tree.bloom_filter_stats().estimatedFalsePositiveRate;
+        }
+        // Random 64 bit keys all but never hit, the hits are drawn from the tree's keys
+        vector<uint64_t> lookups(numLookups);
+        for(uint64_t i = 0; i < numLookups; ++i) {
+            lookups[i] = rng.below(100) < missPercent ? rng.next() : keys[rng.below(numKeys)];
+        }
+        uint64_t found = 0;
+        timer.restart();
+        for(uint64_t i = 0; i < numLookups; ++i) {
+            found += (tree.find(lookups[i]) != tree.end());
+        }
+        double ns = timer.elapsedNs();
+        benchKeep(found);
+        return ns / numLookups;
+    }
+
+    double rate;
+    Measure measure;
+    uint64_t numKeys;
+    uint64_t numLookups;
+    uint64_t missPercent;
+};
+
+int main(int argc, char *argv[])
+{
+    uint64_t numKeys = argc > 1 ? strtoull(argv[1], NULL, 10) : 4000000;
+    uint64_t numLookups = argc > 2 ? strtoull(argv[2], NULL, 10) : 2000000;
+    uint64_t missPercent = argc > 3 ? strtoull(argv[3], NULL, 10) : 80;
+    const double rates[] = { 0, 0.1, 0.01, 0.001 };
+
+    cout << "keys,miss_percent,target_rate,find_ns,insert_ns,filter_bytes_per_key,estimated_rate" << endl;
+    for(size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); ++i) {
+        cout << numKeys << "," << missPercent << "," << (rates[i] == 0 ? string("none") : to_string(rates[i]))
+             << "," << runIsolated(RunBloom(rates[i], FIND, numKeys, numLookups, missPercent))
+             << "," << runIsolated(RunBloom(rates[i], INSERT, numKeys, numLookups, missPercent));
+        if(rates[i] == 0) {
+            cout << ",," << endl;
+            continue;
+        }
+        cout << "," << runIsolated(RunBloom(rates[i], BYTES_PER_KEY, numKeys, numLookups, missPercent))
+             << "," << runIsolated(RunBloom(rates[i], RATE, numKeys, numLookups, missPercent)) << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include "avlbst.h"
+#include "bench-utils.h"
+
+using namespace std;
+
+// The branchless search that integral keys get (see BranchlessSearch in bst.h)
+// against the generic search, on random keys. WrappedKey holds the same
+// uint64_t but is not integral, so its trees take the generic path.
+// Usage: ./branchless-bench [numKeys] [numLookups]
+
+struct WrappedKey
+{
+    uint64_t v;
+    WrappedKey() : v(0) {}
+    WrappedKey(uint64_t x) : v(x) {}
+    bool operator<(const WrappedKey& o) const { return v < o.v; }
+    bool operator>(const WrappedKey& o) const { return v > o.v; }
+    bool operator==(const WrappedKey& o) const { return v == o.v; }
+};
+
+// Needed by the tree's print()
+ostream& operator<<(ostream& out, const WrappedKey& k)
+{
+    return out << k.v;
+}
+
+template<class Key>
+void run(const char* path, const vector<uint64_t>& keys, const vector<uint64_t>& lookups)
+{
+    AVLTree<Key, uint64_t> tree;
+    BenchTimer timer;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        // Odd keys only, so half of the lookups below miss
+        tree.insert(make_pair(Key(2 * keys[i] + 1), keys[i]));
+    }
+    double insertSecs = timer.elapsedSec();
+
+    timer.restart();
+    uint64_t found = 0;
+    for(size_t i = 0; i < lookups.size(); ++i) {
+        found += (tree.find(Key(lookups[i])) != tree.end());
+    }
+    double findSecs = timer.elapsedSec();
+    benchKeep(found);
+    cout << path << "," << keys.size() << "," << lookups.size() << ","
+         << insertSecs * 1e9 / keys.size() << "," << findSecs * 1e9 / lookups.size() << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t maxKeys = argc > 1 ? strtoull(argv[1], NULL, 10) : 4000000;
+    uint64_t numLookups = argc > 2 ? strtoull(argv[2], NULL, 10) : 4000000;
+
+    cout << "path,keys,lookups,insert_ns,find_ns" << endl;
+    for(uint64_t numKeys = 1000; numKeys <= maxKeys; numKeys *= 10) {
+        vector<uint64_t> keys = shuffledKeys(numKeys, 1);
+        vector<uint64_t> lookups(numLookups);
+        BenchRandom rng(2);
+        for(size_t i = 0; i < lookups.size(); ++i) {
+            lookups[i] = rng.below(2 * numKeys);
+        }
+        run<WrappedKey>("generic", keys, lookups);
+        run<uint64_t>("branchless", keys, lookups);
+    }
+    return 0;
+}
@@ -0,0 +1,181 @@
+#ifndef BST_BLOOM_FILTER_H
+#define BST_BLOOM_FILTER_H
+
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+* What BinarySearchTree::bloom_filter_stats() reports. The estimate is the
+* chance that a key which is not in the tree gets past the filter, worked out
+* from how many of the filter's bits are set right now.
+*/
+struct BloomFilterStats
+{
+    double targetFalsePositiveRate;
+    double estimatedFalsePositiveRate;
+    uint64_t keys;       // keys added since the last rebuild, removed ones included
+    uint64_t capacity;   // keys it was sized for, it is rebuilt when it gets there
+    uint64_t removed;    // keys removed from the tree since the last rebuild, their bits are still set
+    uint64_t bytes;
+    int hashes;          // bits set per key
+    uint64_t rebuilds;   // times it was emptied and filled again, the first build included
+};
+
+/**
+* The optional Bloom filter of a tree (see BinarySearchTree::setBloomFilter).
+* It answers "definitely not there" for most keys that are not in the tree, so
+* those searches end before the descent starts. Keys can only be added: a
+* removed key's bits stay set (it is not a false negative, just a false
+* positive more) until the tree rebuilds the filter from its nodes.
+*
+* Blocked: all bits of a key lie in one 512 bit block, so a check touches one
+* or two cache lines instead of one per bit. That costs a little accuracy
+* against a plain Bloom filter with the same memory, as some blocks get more
+* keys than others; the filter is sized from the target rate as if it were a
+* plain one, with room for twice the keys it is built with.
+*/
+template <typename Key>
+class BlockedBloomFilter
+{
+public:
+    typedef size_t (*HashFunction)(const Key& key);
+
+    BlockedBloomFilter(double falsePositiveRate, HashFunction hash) :
+        hash_(hash), rate_(falsePositiveRate), keys_(0), removed_(0), capacity_(0), rebuilds_(0)
+    {
+        // The usual optimum: -ln(p)/ln(2)^2 bits per key and ln(2) times that many hashes
+        bitsPerKey_ = -std::log(falsePositiveRate) / (std::log(2.0) * std::log(2.0));
+        hashes_ = static_cast<int>(bitsPerKey_ * std::log(2.0) + 0.5);
+        hashes_ = hashes_ < 1 ? 1 : (hashes_ > 16 ? 16 : hashes_);
+    }
+
+    // Empties the filter and sizes it for capacity keys
+    void reset(size_t capacity)
+    {
+        capacity = capacity < 64 ? 64 : capacity;
+        size_t blocks = static_cast<size_t>(std::ceil(capacity * bitsPerKey_ / kBlockBits));
+        std::vector<uint64_t> words(blocks * kBlockWords, 0);
+        words_.swap(words);
+        capacity_ = capacity;
+        keys_ = 0;
+        removed_ = 0;
+        ++rebuilds_;
+    }
+
+    // Empties the filter and keeps its size, needs no memory
+    void clear()
+    {
+        std::fill(words_.begin(), words_.end(), 0);
+        keys_ = 0;
+        removed_ = 0;
+    }
+
+    void add(const Key& key)
+    {
+        uint64_t h = mix(key);
+        uint64_t* block = &words_[blockOf(h) * kBlockWords];
+        uint64_t bits = h;
+        for(int i = 0; i < hashes_; ++i) {
+            uint32_t bit = nextBit(bits);
+            block[bit / 64] |= uint64_t(1) << (bit % 64);
+        }
+        ++keys_;
+    }
+
+    // False means key was never added since the last reset
+    bool mayContain(const Key& key) const
+    {
+        if(words_.empty()) {
+            return false;
+        }
+        uint64_t h = mix(key);
+        const uint64_t* block = &words_[blockOf(h) * kBlockWords];
+        uint64_t bits = h;
+        for(int i = 0; i < hashes_; ++i) {
+            uint32_t bit = nextBit(bits);
+            if((block[bit / 64] & (uint64_t(1) << (bit % 64))) == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // A key added before left the tree, its bits stay set until the next reset
+    void noteRemoved() { ++removed_; }
+
+    // Whether the next key would take it past the keys it was sized for
+    bool full() const { return keys_ >= capacity_; }
+    // Whether removes left behind as many keys as half the tree it was built for
+    bool stale() const { return removed_ * 4 >= capacity_; }
+
+    BloomFilterStats stats() const
+    {
+        // A missing key gets through if all its bits in its block are set, blocks differ in how full they are
+        double passing = 0;
+        for(size_t b = 0; b < words_.size(); b += kBlockWords) {
+            size_t set = 0;
+            for(size_t i = b; i < b + kBlockWords; ++i) {
+                set += std::bitset<64>(words_[i]).count();
+            }
+            passing += std::pow(double(set) / kBlockBits, hashes_);
+        }
+        BloomFilterStats s;
+        s.targetFalsePositiveRate = rate_;
+        s.estimatedFalsePositiveRate = words_.empty() ? 0 : passing / (words_.size() / kBlockWords);
+        s.keys = keys_;
+        s.capacity = capacity_;
+        s.removed = removed_;
+        s.bytes = bytes();
+        s.hashes = hashes_;
+        s.rebuilds = rebuilds_;
+        return s;
+    }
+
+    double falsePositiveRate() const { return rate_; }
+    HashFunction hashFunction() const { return hash_; }
+    size_t bytes() const { return words_.capacity() * sizeof(uint64_t) + sizeof(*this); }
+
+private:
+    static const uint32_t kBlockBits = 512;
+    static const size_t kBlockWords = kBlockBits / 64;
+
+    // MurmurHash3's finalizer, std::hash of an integer is the integer itself
+    uint64_t mix(const Key& key) const
+    {
+        uint64_t h = static_cast<uint64_t>(hash_(key));
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return h;
+    }
+    // The bit positions in the block: every step multiplies the hash by an odd constant and
+    // takes the top 9 bits, which depend on all the bits below them
+    static uint32_t nextBit(uint64_t& bits)
+    {
+        bits *= 0x9E3779B97F4A7C15ull;
+        return static_cast<uint32_t>(bits >> 55);
+    }
+    // The top 32 bits scaled to the number of blocks, no division needed
+    size_t blockOf(uint64_t h) const
+    {
+        return static_cast<size_t>(((h >> 32) * (words_.size() / kBlockWords)) >> 32);
+    }
+
+    HashFunction hash_;
+    double rate_;
+    double bitsPerKey_;
+    int hashes_;
+    std::vector<uint64_t> words_;
+    size_t keys_;
+    size_t removed_;
+    size_t capacity_;
+    uint64_t rebuilds_;
+};
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef BST_HASH_INDEX_H
+#define BST_HASH_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+template <typename Key, typename Value>
+class Node;
+
+// Hashes a key for NodeHashIndex, only instantiated for trees that turn an index on
+template <typename Key>
+size_t stdHashKey(const Key& key)
+{
+    return std::hash<Key>()(key);
+}
+
+/**
+* The optional hash index of a tree (see BinarySearchTree::setHashIndex):
+* an open addressing table from key to node, so finding a key costs O(1)
+* instead of a descent of the tree. Nodes stay where they are while the tree
+* rebalances, rotations and nodeSwap only relink them, so the tree only has
+* to tell the index about nodes it creates and frees.
+*
+* Linear probing over a power of two table that is at most 3/4 full. Every
+* slot keeps the key's hash next to the node, so probing past other keys and
+* growing the table never has to look at a node; only a slot with the same
+* hash costs a visit to its node to compare the keys. Removes shift the
+* following slots back instead of leaving tombstones behind.
+*/
+template <typename Key, typename Value>
+class NodeHashIndex
+{
+public:
+    typedef size_t (*HashFunction)(const Key& key);
+
+    explicit NodeHashIndex(HashFunction hash) : hash_(hash), shift_(64), used_(0) {}
+
+    Node<Key, Value>* find(const Key& key) const
+    {
+        if(used_ == 0) {
+            return NULL;
+        }
+        uint64_t h = mix(key);
+        for(size_t i = h >> shift_; ; i = (i + 1) & mask()) {
+            const Slot& slot = slots_[i];
+            if(slot.node == NULL) {
+                return NULL;
+            }
+            if(slot.hash == h && slot.node->getKey() == key) {
+                return slot.node;
+            }
+        }
+    }
+
+    // n's key must not be in the index yet
+    void insert(Node<Key, Value>* n)
+    {
+        if((used_ + 1) * 4 > slots_.size() * 3) {
+            grow();
+        }
+        Slot slot = { n, mix(n->getKey()) };
+        place(slot);
+        ++used_;
+    }
+
+    void erase(Node<Key, Value>* n)
+    {
+        if(used_ == 0) {
+            return;
+        }
+        size_t i = mix(n->getKey()) >> shift_;
+        while(slots_[i].node != n) {
+            if(slots_[i].node == NULL) {
+                return;
+            }
+            i = (i + 1) & mask();
+        }
+        // Pull back every later slot of the run that may sit at or before the hole
+        for(size_t next = (i + 1) & mask(); slots_[next].node != NULL; next = (next + 1) & mask()) {
+            size_t home = slots_[next].hash >> shift_;
+            if(((next - home) & mask()) >= ((next - i) & mask())) {
+                slots_[i] = slots_[next];
+                i = next;
+            }
+        }
+        slots_[i].node = NULL;
+        --used_;
+    }
+
+    // Forgets every node, keeping the table for reuse
+    void clear()
+    {
+        for(size_t i = 0; i < slots_.size(); ++i) {
+            slots_[i].node = NULL;
+        }
+        used_ = 0;
+    }
+
+    size_t size() const { return used_; }
+    HashFunction hashFunction() const { return hash_; }
+    size_t bytes() const { return slots_.capacity() * sizeof(Slot) + sizeof(*this); }
+
+private:
+    struct Slot
+    {
+        Node<Key, Value>* node;
+        uint64_t hash;
+    };
+
+    // Fibonacci hashing, so keys like multiples of a power of two still spread over the table
+    uint64_t mix(const Key& key) const
+    {
+        return static_cast<uint64_t>(hash_(key)) * 0x9E3779B97F4A7C15ull;
+    }
+    size_t mask() const { return slots_.size() - 1; }
+
+    static void place(std::vector<Slot>& slots, int shift, const Slot& slot)
+    {
+        size_t mask = slots.size() - 1;
+        size_t i = slot.hash >> shift;
+        while(slots[i].node != NULL) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = slot;
+    }
+    void place(const Slot& slot) { place(slots_, shift_, slot); }
+
+    // The new table is filled on the side, so if allocating it throws the index stays as it was
+    void grow()
+    {
+        size_t capacity = slots_.empty() ? 16 : slots_.size() * 2;
+        int shift = slots_.empty() ? 60 : shift_ - 1;
+        Slot empty = { NULL, 0 };
+        std::vector<Slot> slots(capacity, empty);
+        for(size_t i = 0; i < slots_.size(); ++i) {
+            if(slots_[i].node != NULL) {
+                place(slots, shift, slots_[i]);
+            }
+        }
+        slots_.swap(slots);
+        shift_ = shift;
+    }
+
+    HashFunction hash_;
+    std::vector<Slot> slots_;
+    int shift_;    // 64 - log2 of the table size, the top bits of a hash pick its home slot
+    size_t used_;
+};
+
+#endif
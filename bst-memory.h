@@ -0,0 +1,231 @@
+#ifndef BST_MEMORY_H
+#define BST_MEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <type_traits>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+/**
+* Where a tree gets the memory for its nodes from, shaped like C++17's
+* std::pmr::memory_resource (which this C++11 code can not use). A tree
+* takes a resource in its constructor and makes every node allocation and
+* deallocation through it, insert, remove and clear() included. The
+* resource has to outlive every tree using it.
+*
+* usable_size() and block_overhead() let memory_usage() report what the
+* resource really hands out. releases_all_at_once() tells a tree that
+* deallocate() does nothing and the memory goes back all together, so
+* there is no point in visiting the nodes one by one to free them.
+*/
+class TreeMemoryResource
+{
+public:
+    virtual ~TreeMemoryResource() {}
+    virtual void* allocate(size_t bytes, size_t alignment) = 0;
+    virtual void deallocate(void* p, size_t bytes, size_t alignment) = 0;
+    virtual size_t usable_size(const void*, size_t bytes) const { return bytes; }
+    virtual size_t block_overhead() const { return 0; }
+    virtual bool releases_all_at_once() const { return false; }
+};
+
+/**
+* The default resource: ::operator new and ::operator delete.
+*/
+class NewDeleteTreeResource : public TreeMemoryResource
+{
+public:
+    void* allocate(size_t bytes, size_t) { return ::operator new(bytes); }
+    void deallocate(void* p, size_t, size_t) { ::operator delete(p); }
+#ifdef __GLIBC__
+    // glibc rounds requests up and keeps a size word in front of every block
+    size_t usable_size(const void* p, size_t) const { return malloc_usable_size(const_cast<void*>(p)); }
+    size_t block_overhead() const { return sizeof(size_t); }
+#endif
+};
+
+/**
+* The resource trees use when they are not given one.
+*/
+inline TreeMemoryResource* defaultTreeResource()
+{
+    static NewDeleteTreeResource resource;
+    return &resource;
+}
+
+/**
+* An arena: hands out memory from large blocks by bumping a pointer and never
+* frees single allocations. Everything goes back to the upstream resource at
+* once in release() or the destructor. Like std::pmr::monotonic_buffer_resource,
+* each new block is twice the size of the last one.
+*
+* Meant for short lived trees, e.g. one per request: a tree in an arena with
+* trivially destructible keys and values is destroyed without visiting its
+* nodes, and the arena then frees them all.
+*/
+class MonotonicTreeResource : public TreeMemoryResource
+{
+public:
+    explicit MonotonicTreeResource(size_t firstBlockBytes = 64 << 10, TreeMemoryResource* upstream = NULL) :
+        upstream_(upstream != NULL ? upstream : defaultTreeResource()), blocks_(NULL), current_(NULL),
+        remaining_(0), firstBlockBytes_(firstBlockBytes < 256 ? 256 : firstBlockBytes),
+        nextBlockBytes_(firstBlockBytes_), allocated_(0) {}
+    ~MonotonicTreeResource() { release(); }
+
+    void* allocate(size_t bytes, size_t alignment)
+    {
+        size_t padding = (alignment - reinterpret_cast<uintptr_t>(current_) % alignment) % alignment;
+        if(current_ == NULL || padding + bytes > remaining_) {
+            newBlock(bytes + alignment);
+            padding = (alignment - reinterpret_cast<uintptr_t>(current_) % alignment) % alignment;
+        }
+        void* p = current_ + padding;
+        current_ += padding + bytes;
+        remaining_ -= padding + bytes;
+        return p;
+    }
+    void deallocate(void*, size_t, size_t) {}
+    bool releases_all_at_once() const { return true; }
+
+    // Gives every block back to the upstream resource and starts over
+    void release()
+    {
+        while(blocks_ != NULL) {
+            Block* next = blocks_->next;
+            upstream_->deallocate(blocks_, blocks_->bytes, alignof(Block));
+            blocks_ = next;
+        }
+        current_ = NULL;
+        remaining_ = 0;
+        nextBlockBytes_ = firstBlockBytes_;
+        allocated_ = 0;
+    }
+    // Bytes taken from upstream so far
+    size_t bytes_allocated() const { return allocated_; }
+
+private:
+    struct Block
+    {
+        Block* next;
+        size_t bytes;
+    };
+
+    void newBlock(size_t atLeast)
+    {
+        size_t bytes = nextBlockBytes_;
+        while(bytes < atLeast + sizeof(Block)) bytes *= 2;
+        Block* block = static_cast<Block*>(upstream_->allocate(bytes, alignof(Block)));
+        block->next = blocks_;
+        block->bytes = bytes;
+        blocks_ = block;
+        current_ = reinterpret_cast<char*>(block + 1);
+        remaining_ = bytes - sizeof(Block);
+        allocated_ += bytes;
+        nextBlockBytes_ = bytes * 2;
+    }
+
+    TreeMemoryResource* upstream_;
+    Block* blocks_;
+    char* current_;
+    size_t remaining_;
+    size_t firstBlockBytes_;
+    size_t nextBlockBytes_;
+    size_t allocated_;
+
+    // The blocks belong to this object
+    MonotonicTreeResource(const MonotonicTreeResource&);
+    MonotonicTreeResource& operator=(const MonotonicTreeResource&);
+};
+
+/**
+* The block compact() moves a tree's nodes into: slots for a fixed number of
+* nodes in one allocation from the upstream resource, handed out in order.
+* Slots of removed nodes are reused, everything else (more nodes than slots,
+* out of line values) comes from the upstream resource.
+*
+* It counts what was allocated through it and deletes itself, giving the block
+* back, once the tree has called release() and the last of it is freed. Nodes
+* a tree detached (see DetachedNodes) can so still be freed through it later.
+* Only trees make these, with new.
+*/
+class CompactNodeBlock : public TreeMemoryResource
+{
+public:
+    CompactNodeBlock(size_t slots, size_t slotBytes, size_t slotAlign, TreeMemoryResource* upstream) :
+        upstream_(upstream), slotBytes_(slotBytes), slotAlign_(slotAlign), blockBytes_(slots * slotBytes),
+        block_(static_cast<char*>(upstream->allocate(blockBytes_, slotAlign))), next_(block_), free_(NULL),
+        live_(0), released_(false) {}
+
+    void* allocate(size_t bytes, size_t alignment)
+    {
+        void* p;
+        if(bytes == slotBytes_ && alignment <= slotAlign_ && free_ != NULL) {
+            p = free_;
+            free_ = *static_cast<void**>(p);
+        }
+        else if(bytes == slotBytes_ && alignment <= slotAlign_ && next_ != block_ + blockBytes_) {
+            p = next_;
+            next_ += slotBytes_;
+        }
+        else {
+            p = upstream_->allocate(bytes, alignment);
+        }
+        ++live_;
+        return p;
+    }
+    void deallocate(void* p, size_t bytes, size_t alignment)
+    {
+        if(inBlock(p)) {
+            *static_cast<void**>(p) = free_;
+            free_ = p;
+        }
+        else {
+            upstream_->deallocate(p, bytes, alignment);
+        }
+        if(--live_ == 0 && released_) {
+            delete this;
+        }
+    }
+    size_t usable_size(const void* p, size_t bytes) const
+    {
+        return inBlock(p) ? bytes : upstream_->usable_size(p, bytes);
+    }
+    // Nodes in the block have none, and they are the bulk of it
+    size_t block_overhead() const { return 0; }
+
+    // The tree is done with the block, it goes once nothing allocated from it is left
+    void release()
+    {
+        released_ = true;
+        if(live_ == 0) {
+            delete this;
+        }
+    }
+    TreeMemoryResource* upstream() const { return upstream_; }
+
+private:
+    ~CompactNodeBlock() { upstream_->deallocate(block_, blockBytes_, slotAlign_); }
+    bool inBlock(const void* p) const
+    {
+        return std::less_equal<const void*>()(block_, p) && std::less<const void*>()(p, block_ + blockBytes_);
+    }
+
+    TreeMemoryResource* upstream_;
+    size_t slotBytes_;
+    size_t slotAlign_;
+    size_t blockBytes_;
+    char* block_;
+    char* next_;   // the first slot never handed out
+    void* free_;   // freed slots, linked through their first word
+    size_t live_;
+    bool released_;
+
+    CompactNodeBlock(const CompactNodeBlock&);
+    CompactNodeBlock& operator=(const CompactNodeBlock&);
+};
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef BST_SNAPSHOT_H
+#define BST_SNAPSHOT_H
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+
+/**
+* Layout of a tree snapshot written by BinarySearchTree::save():
+*
+*   header   magic "BSTSNAP1", uint32 version, uint32 key size, uint32 value
+*            size, uint64 number of entries. A size of 0 means the type is
+*            written by a custom serializer instead of as raw bytes.
+*   entries  key, value, key, value, ... in increasing key order.
+*
+* Numbers and raw types are stored in the machine's own byte order, so a
+* snapshot is meant to be loaded on the same kind of machine that wrote it.
+*/
+static const char kSnapshotMagic[8] = { 'B', 'S', 'T', 'S', 'N', 'A', 'P', '1' };
+static const uint32_t kSnapshotVersion = 1;
+
+/**
+* Buffers the small writes of a snapshot so the stream sees large blocks.
+* flush() (or the destructor) hands the rest to the stream.
+*/
+class SnapshotWriter
+{
+public:
+    explicit SnapshotWriter(std::ostream& out) : out_(out), used_(0), buffer_(kBufferSize) {}
+    ~SnapshotWriter() { flush(); }
+
+    void write(const void* data, size_t size)
+    {
+        if(used_ + size > buffer_.size()) {
+            flush();
+            if(size > buffer_.size()) {
+                out_.write(static_cast<const char*>(data), size);
+                return;
+            }
+        }
+        memcpy(&buffer_[used_], data, size);
+        used_ += size;
+    }
+
+    template<typename T>
+    void writeRaw(const T& value) { write(&value, sizeof(T)); }
+
+    void flush()
+    {
+        if(used_ > 0) out_.write(&buffer_[0], used_);
+        used_ = 0;
+    }
+
+private:
+    static const size_t kBufferSize = 1 << 16;
+    std::ostream& out_;
+    size_t used_;
+    std::vector<char> buffer_;
+};
+
+/**
+* Reads a snapshot in large blocks. Running out of data throws std::runtime_error.
+* Call finish() once the snapshot is read.
+*/
+class SnapshotReader
+{
+public:
+    explicit SnapshotReader(std::istream& in) : in_(in), pos_(0), end_(0), buffer_(kBufferSize) {}
+
+    void read(void* data, size_t size)
+    {
+        char* dest = static_cast<char*>(data);
+        while(size > 0) {
+            if(pos_ == end_ && !refill()) {
+                throw std::runtime_error("tree snapshot is truncated");
+            }
+            size_t n = std::min(size, end_ - pos_);
+            memcpy(dest, &buffer_[pos_], n);
+            pos_ += n;
+            dest += n;
+            size -= n;
+        }
+    }
+
+    template<typename T>
+    void readRaw(T& value) { read(&value, sizeof(T)); }
+
+    // Gives the bytes read ahead back to a seekable stream, so whatever follows
+    // the snapshot in the stream can still be read from there
+    void finish()
+    {
+        in_.clear();
+        if(pos_ < end_) in_.seekg(-static_cast<std::streamoff>(end_ - pos_), std::ios::cur);
+        pos_ = end_ = 0;
+    }
+
+private:
+    bool refill()
+    {
+        in_.read(&buffer_[0], buffer_.size());
+        pos_ = 0;
+        end_ = static_cast<size_t>(in_.gcount());
+        return end_ > 0;
+    }
+
+    static const size_t kBufferSize = 1 << 16;
+    std::istream& in_;
+    size_t pos_;
+    size_t end_;
+    std::vector<char> buffer_;
+};
+
+/**
+* How keys and values are written to a snapshot. Trivially copyable types are
+* copied as raw bytes. Any other type needs a specialization with the same
+* three members, e.g. for a struct Point:
+*
+*   template<> struct BSTSerializer<Point> {
+*       static const uint32_t kRawSize = 0;
+*       static void write(SnapshotWriter& out, const Point& p) { ... }
+*       static void read(SnapshotReader& in, Point& p) { ... }
+*   };
+*
+* kRawSize is sizeof(T) for raw types and 0 otherwise, it goes into the header
+* so a snapshot is not loaded into a tree with differently sized types.
+*/
+template<typename T, typename Enable = void>
+struct BSTSerializer
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "BSTSerializer has to be specialized for types that are not trivially copyable");
+};
+
+template<typename T>
+struct BSTSerializer<T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type>
+{
+    static const uint32_t kRawSize = sizeof(T);
+    static void write(SnapshotWriter& out, const T& value) { out.writeRaw(value); }
+    static void read(SnapshotReader& in, T& value) { in.readRaw(value); }
+};
+
+/**
+* Strings are written as a uint64 length followed by the characters.
+*/
+template<>
+struct BSTSerializer<std::string>
+{
+    static const uint32_t kRawSize = 0;
+    static void write(SnapshotWriter& out, const std::string& value)
+    {
+        out.writeRaw(static_cast<uint64_t>(value.size()));
+        out.write(value.data(), value.size());
+    }
+    static void read(SnapshotReader& in, std::string& value)
+    {
+        uint64_t size;
+        in.readRaw(size);
+        value.resize(size);
+        if(size > 0) in.read(&value[0], size);
+    }
+};
+
+#endif
@@ -1,7 +1,16 @@
 #include <iostream>
+#include <fstream>
 #include <map>
+#include <sstream>
+#include <string>
 #include "bst.h"
 #include "avlbst.h"
+#include "rbbst.h"
+#include "splaybst.h"
+#include "mmap-avlbst.h"
+#include "buffered-tree.h"
+#include "merged-view.h"
+#include "logged-tree.h"
 
 using namespace std;
 
@@ -23,6 +32,12 @@ int main(int argc, char *argv[])
     else {
         cout << "Did not find b" << endl;
     }
+    bt.setScapegoatAlpha(0.7);
+    for(char c = 'c'; c <= 'z'; ++c) {
+        bt.insert(std::make_pair(c, c - 'a'));
+    }
+    bt.rebalance();
+    cout << "Sorted inserts: " << bt.size() << " keys, balanced " << bt.isBalanced() << endl;
     cout << "Erasing b" << endl;
     bt.remove('b');
 
@@ -41,8 +56,190 @@ int main(int argc, char *argv[])
     else {
         cout << "Did not find b" << endl;
     }
+    std::vector<char> wanted;
+    wanted.push_back('b');
+    wanted.push_back('z');
+    std::vector<AVLTree<char,int>::iterator> results;
+    at.find_many(wanted, results);
+    cout << "find_many b/z: " << (results[0] != at.end()) << " " << (results[1] != at.end()) << endl;
+    at.find_sorted(wanted, results);
+    cout << "find_sorted b/z: " << (results[0] != at.end()) << " " << (results[1] != at.end()) << endl;
+    std::stringstream snapshot;
+    at.save(snapshot);
+    AVLTree<char,int> restored;
+    restored.load(snapshot);
+    cout << "Restored from snapshot:";
+    for(AVLTree<char,int>::iterator it = restored.begin(); it != restored.end(); ++it) {
+        cout << " " << it->first << "=" << it->second;
+    }
+    cout << endl;
+    MemoryUsage usage = at.memory_usage();
+    cout << "size " << at.size() << ", node bytes " << usage.nodeBytes << ", total bytes " << usage.total() << endl;
+    at.compact();
+    cout << "After compact size " << at.size() << ", found b " << (at.find('b') != at.end()) << endl;
+    MonotonicTreeResource arena;
+    AVLTree<char,int> arenaTree(&arena);
+    arenaTree.insert(std::make_pair('x', 24));
+    arenaTree.insert(std::make_pair('y', 25));
+    cout << "Arena tree size " << arenaTree.size() << ", arena bytes " << arena.bytes_allocated() << endl;
+    AVLTree<char,int> copied(at);
+    AVLTree<char,int> moved(std::move(restored));
+    AVLTree<std::string,int> symbols;
+    symbols.insert(std::make_pair(std::string("map_find"), 1));
+    symbols.insert(std::make_pair(std::string("map_insert_sorted"), 2));
+    symbols.insert(std::make_pair(std::string("max"), 3));
+    std::pair<AVLTree<std::string,int>::iterator, AVLTree<std::string,int>::iterator> range = symbols.prefix_range("map_");
+    cout << "Keys starting with map_:";
+    for(AVLTree<std::string,int>::iterator it = range.first; it != range.second; ++it) {
+        cout << " " << it->first;
+    }
+    cout << endl;
+    AVLTree<int,int> burst;
+    burst.setRelaxedBalance(true);
+    for(int i = 0; i < 8; ++i) {
+        burst.insert(std::make_pair(i, i));
+    }
+    cout << "Relaxed inserts pending " << burst.pending_rebalances();
+    burst.rebalance_pending();
+    cout << ", after rebalance_pending " << burst.pending_rebalances() << ", balanced " << burst.isBalanced() << endl;
+    BufferedTree<int,int> ingest(4);
+    for(int i = 5; i > 0; --i) {
+        ingest.insert(std::make_pair(i, i));
+    }
+    ingest.remove(2);
+    ingest.insert(std::make_pair(9, 9));
+    cout << "Buffered ops " << ingest.buffered() << ", keys:";
+    for(BufferedTree<int,int>::iterator it = ingest.begin(); it != ingest.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << ", tree size after flush " << ingest.tree().size() << endl;
+    AVLTree<int,int> older;
+    AVLTree<int,int> newer;
+    older.insert(std::make_pair(1, 10));
+    older.insert(std::make_pair(3, 10));
+    newer.insert(std::make_pair(2, 20));
+    newer.insert(std::make_pair(3, 20));
+    MergedView<int,int> shards(MergedView<int,int>::LAST_WINS);
+    shards.add(older);
+    shards.add(newer);
+    cout << "Merged view:";
+    for(MergedView<int,int>::iterator it = shards.lower_bound(2); it != shards.end(); ++it) {
+        cout << " " << it->first << "=" << it->second;
+    }
+    cout << endl;
+    AVLTree<int,int> indexed;
+    indexed.setHashIndex(true);
+    for(int i = 0; i < 100; ++i) {
+        indexed.insert(std::make_pair(i, i * i));
+    }
+    indexed.remove(50);
+    cout << "Hash index: 7 -> " << indexed[7] << ", 50 found " << (indexed.find(50) != indexed.end())
+         << ", index bytes " << (indexed.memory_usage().indexBytes > 0) << endl;
+    indexed.setBloomFilter(0.01);
+    indexed.remove(60);
+    BloomFilterStats bloom = indexed.bloom_filter_stats();
+    cout << "Bloom filter: 7 found " << (indexed.find(7) != indexed.end()) << ", 60 found " << (indexed.find(60) != indexed.end())
+         << ", " << bloom.hashes << " hashes, estimated rate below target " << (bloom.estimatedFalsePositiveRate < 0.01) << endl;
+    cout << "Copy size " << copied.size() << ", moved size " << moved.size() << ", moved-from size " << restored.size() << endl;
+    int slices = 1;
+    while(!copied.clear_incremental(1)) {
+        ++slices;
+    }
+    copied.insert(std::make_pair('c',3));
+    cout << "Incremental clear took " << slices << " slices, size after reuse " << copied.size() << endl;
     cout << "Erasing b" << endl;
     at.remove('b');
 
+    // Red Black Tree Tests
+    RBTree<char,int> rt;
+    rt.insert(std::make_pair('a',1));
+    rt.insert(std::make_pair('b',2));
+    rt.insert(std::make_pair('c',3));
+
+    cout << "\nRBTree contents:" << endl;
+    for(RBTree<char,int>::iterator it = rt.begin(); it != rt.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+    if(rt.find('b') != rt.end()) {
+        cout << "Found b" << endl;
+    }
+    else {
+        cout << "Did not find b" << endl;
+    }
+    cout << "Erasing b" << endl;
+    rt.remove('b');
+
+    // Splay Tree Tests
+    SplayTree<char,int> st;
+    st.insert(std::make_pair('a',1));
+    st.insert(std::make_pair('b',2));
+    st.insert(std::make_pair('c',3));
+
+    cout << "\nSplayTree contents:" << endl;
+    for(SplayTree<char,int>::iterator it = st.begin(); it != st.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+    if(st.find('a') != st.end()) {
+        cout << "Found a" << endl;
+    }
+    else {
+        cout << "Did not find a" << endl;
+    }
+    cout << "Erasing b" << endl;
+    st.remove('b');
+
+    // Memory mapped AVL Tree Tests, the second open sees what the first one wrote
+    const char* treeFile = "bst-test.tree";
+    {
+        PersistentAVLTree<char,int> pt(treeFile);
+        pt.clear();
+        pt.insert(std::make_pair('a',1));
+        pt.insert(std::make_pair('b',2));
+        pt.insert(std::make_pair('c',3));
+        pt.remove('b');
+        pt.sync();
+    }
+    PersistentAVLTree<char,int> reopened(treeFile, PersistentAVLTree<char,int>::ReadOnly);
+    cout << "\nPersistentAVLTree contents after reopening:" << endl;
+    for(PersistentAVLTree<char,int>::iterator it = reopened.begin(); it != reopened.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+    remove(treeFile);
+
+    // Logged tree: recovery replays the log over the checkpoint and cuts off a torn frame
+    const char* logFile = "bst-test-wal";
+    {
+        LoggedTree<int,int> lt(logFile, 0, 0);
+        for(int i = 0; i < 10; ++i) {
+            lt.insert(std::make_pair(i, i));
+        }
+        lt.checkpoint();
+        for(int i = 10; i < 15; ++i) {
+            lt.insert(std::make_pair(i, i));
+        }
+        lt.remove(3);
+        lt.commit();
+    }
+    {
+        // A frame header that promises more bytes than follow, as a crash mid-write leaves it
+        std::ofstream torn((std::string(logFile) + ".log").c_str(), std::ios::binary | std::ios::app);
+        uint32_t header[4] = { 0x4c474654, 100, 1, 0 };
+        torn.write(reinterpret_cast<const char*>(header), sizeof(header));
+        torn.write("abc", 3);
+    }
+    size_t recovered;
+    {
+        LoggedTree<int,int> lt(logFile, 0, 0);
+        recovered = lt.tree().size();
+        cout << "\nRecovered log: size " << recovered << ", 3 found " << (lt.find(3) != lt.end())
+             << ", 14 found " << (lt.find(14) != lt.end());
+        lt.insert(std::make_pair(20, 20));
+        lt.commit();
+    }
+    LoggedTree<int,int> relogged(logFile, 0, 0);
+    cout << ", after another commit " << relogged.tree().size() << ", 20 found " << (relogged.find(20) != relogged.end()) << endl;
+    remove((std::string(logFile) + ".log").c_str());
+    remove((std::string(logFile) + ".ckpt").c_str());
+
     return 0;
 }
@@ -5,6 +5,255 @@
 #include <exception>
 #include <cstdlib>
 #include <utility>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <new>
+#include <type_traits>
+#include <cmath>
+#include <stdexcept>
+#include "bst-snapshot.h"
+#include "bst-memory.h"
+#include "bst-hash-index.h"
+#include "bst-bloom-filter.h"
+
+/**
+* Counters for the hot paths of the trees: how many comparisons and nodes a
+* search costs, how often the balancing rotates or swaps nodes and how many
+* nodes get allocated. Operations counts the insert/remove/find calls, so
+* every other counter can be turned into a per operation average.
+*
+* The counters are only kept when compiled with -DBST_STATS (see DEFS in the
+* Makefile). Without it the BST_COUNT calls compile away, the trees carry no
+* extra data and stats() just returns zeros. The flag changes the class
+* layout, so it has to be the same for every file of a program.
+*/
+struct TreeStats
+{
+    uint64_t operations;
+    uint64_t comparisons;
+    uint64_t nodesVisited;
+    uint64_t rotations;
+    uint64_t nodeSwaps;
+    uint64_t removeFixCalls;      // removeFix steps over all removes
+    uint64_t maxRemoveFixDepth;   // deepest removeFix recursion of a single remove
+    uint64_t allocations;
+    uint64_t deallocations;
+};
+
+/**
+* The memory a tree holds, see BinarySearchTree::memory_usage(). Nodes are
+* allocated one at a time through makeNode(), which records what the
+* tree's TreeMemoryResource really handed out (malloc_usable_size with
+* glibc by default), so these are exact rather than sizeof estimates.
+*/
+struct MemoryUsage
+{
+    uint64_t nodes;
+    uint64_t nodeBytes;       // sizeof the nodes (and their out of line items), what was asked for
+    uint64_t slackBytes;      // what the allocator rounded those requests up by
+    uint64_t overheadBytes;   // the allocator's header in front of every block
+    uint64_t treeBytes;       // the BinarySearchTree part of the tree object
+    uint64_t indexBytes;      // the hash index and Bloom filter, if turned on
+    uint64_t total() const { return nodeBytes + slackBytes + overheadBytes + treeBytes + indexBytes; }
+};
+
+#ifdef BST_STATS
+#define BST_COUNT(field, n) (this->stats_.field += (n))
+#else
+#define BST_COUNT(field, n) ((void)0)
+#endif
+
+// Asks the CPU to start loading the cache lines of a node we will look at soon
+#if defined(__GNUC__)
+#define BST_PREFETCH(p, bytes) (__builtin_prefetch(p), __builtin_prefetch(reinterpret_cast<const char*>(p) + (bytes) - 1))
+#else
+#define BST_PREFETCH(p, bytes) ((void)0)
+#endif
+
+/**
+* Whether the trees search for a Key without branching on its comparisons.
+* A search for a random key goes left or right at random, which the CPU
+* mispredicts about half the time. With this on, each level does a single <
+* whose result indexes the child to go to, the search always runs down to a
+* leaf and the key is only tested for equality once at the bottom.
+*
+* It is on for integral keys, where a comparison is one instruction. Cheap key
+* types of your own can turn it on with a specialization:
+*
+*   template<> struct BranchlessSearch<MyKey> : std::true_type {};
+*/
+template<typename Key, typename Enable = void>
+struct BranchlessSearch : std::false_type {};
+
+template<typename Key>
+struct BranchlessSearch<Key, typename std::enable_if<std::is_integral<Key>::value>::type> : std::true_type {};
+
+/**
+* Extra key data a Node keeps so searches touch less memory. Most keys need
+* none, this is an empty base then and costs no space. compare() is a three
+* way comparison of key against the node's key (negative if key is smaller),
+* prefix is what prefixOf(key) returned for the searched key. Key types that
+* get the prefix search (see SearchTagFor) also need keyPrefix() and
+* compareTied(), like the std::string version below.
+*/
+template<typename Key>
+class NodeKeyPrefix
+{
+public:
+    typedef int Prefix;
+    explicit NodeKeyPrefix(const Key&) {}
+    static Prefix prefixOf(const Key&) { return 0; }
+    int compare(const Key& key, Prefix, const Key& nodeKey) const
+    {
+        return key < nodeKey ? -1 : (nodeKey < key ? 1 : 0);
+    }
+};
+
+/**
+* String keys keep their first 8 characters in the node, packed big endian
+* into an integer (zero padded) so comparing two prefixes as integers orders
+* them like the strings. A comparison only reads the string's characters,
+* which for strings longer than the small string buffer live somewhere else
+* on the heap, when the prefixes tie and one string is longer than 8. The
+* length needs no copy, std::string keeps it inside the node already.
+*/
+template<>
+class NodeKeyPrefix<std::string>
+{
+public:
+    typedef uint64_t Prefix;
+    explicit NodeKeyPrefix(const std::string& key) : keyPrefix_(prefixOf(key)) {}
+    static Prefix prefixOf(const std::string& key)
+    {
+        Prefix prefix = 0;
+        for(size_t i = 0; i < 8; ++i) {
+            prefix = (prefix << 8) | (i < key.size() ? static_cast<unsigned char>(key[i]) : 0);
+        }
+        return prefix;
+    }
+    Prefix keyPrefix() const { return keyPrefix_; }
+    int compare(const std::string& key, Prefix prefix, const std::string& nodeKey) const
+    {
+        if(prefix != keyPrefix_) {
+            return prefix < keyPrefix_ ? -1 : 1;
+        }
+        return compareTied(key, nodeKey);
+    }
+    // Compares two strings whose prefixes are the same
+    static int compareTied(const std::string& key, const std::string& nodeKey)
+    {
+        // Only the characters past the prefix are left, if both strings go on past it
+        if(key.size() > 8 && nodeKey.size() > 8) {
+            int order = memcmp(key.data() + 8, nodeKey.data() + 8, std::min(key.size(), nodeKey.size()) - 8);
+            if(order != 0) {
+                return order;
+            }
+        }
+        // Otherwise the shorter one is a prefix of the other (the prefix pads with zeros)
+        return key.size() < nodeKey.size() ? -1 : (key.size() > nodeKey.size() ? 1 : 0);
+    }
+
+private:
+    Prefix keyPrefix_;
+};
+
+/**
+* Whether nodes keep their value out of line. A search only needs the key and
+* the links of each node it passes, but an inline value sits between the two
+* and pushes them apart, so with a large value every level costs an extra
+* cache line. Values larger than kMaxInlineValueBytes move to their own
+* allocation and the node keeps just the key, links (and balance) together.
+* Can be specialized to choose differently for a type.
+*/
+static const size_t kMaxInlineValueBytes = 64;
+
+template<typename Key, typename Value>
+struct StoreValueOutOfLine : std::integral_constant<bool, (sizeof(Value) > kMaxInlineValueBytes)> {};
+
+/**
+* Where a Node keeps its key/value pair: inline, the usual layout.
+*/
+template<typename Key, typename Value, bool OutOfLine = StoreValueOutOfLine<Key, Value>::value>
+class NodeItem
+{
+public:
+    static const size_t kColdBytes = 0;   // bytes allocated outside the node
+    NodeItem(const Key& key, const Value& value, TreeMemoryResource*) : item_(key, value) {}
+    const Key& key() const { return item_.first; }
+    std::pair<const Key, Value>& item() { return item_; }
+    const std::pair<const Key, Value>& item() const { return item_; }
+    const void* coldBlock() const { return NULL; }
+    void releaseItem(TreeMemoryResource*) {}
+
+protected:
+    std::pair<const Key, Value> item_;
+};
+
+/**
+* Out of line: the pair gets an allocation of its own, which iterators and
+* getItem() hand out as before, and the node keeps a copy of the key to
+* search with. The pair comes from the tree's memory resource, which is not
+* kept in the node, so the tree gives it back with releaseItem() before it
+* destroys the node.
+*/
+template<typename Key, typename Value>
+class NodeItem<Key, Value, true>
+{
+public:
+    typedef std::pair<const Key, Value> Item;
+    static const size_t kColdBytes = sizeof(Item);
+    NodeItem(const Key& key, const Value& value, TreeMemoryResource* resource) : key_(key), item_(NULL)
+    {
+        void* memory = resource->allocate(kColdBytes, alignof(Item));
+        try {
+            item_ = new (memory) Item(key, value);
+        }
+        catch(...) {
+            resource->deallocate(memory, kColdBytes, alignof(Item));
+            throw;
+        }
+    }
+    void releaseItem(TreeMemoryResource* resource)
+    {
+        item_->~Item();
+        resource->deallocate(item_, kColdBytes, alignof(Item));
+        item_ = NULL;
+    }
+    const Key& key() const { return key_; }
+    std::pair<const Key, Value>& item() { return *item_; }
+    const std::pair<const Key, Value>& item() const { return *item_; }
+    const void* coldBlock() const { return item_; }
+
+protected:
+    Key key_;
+    std::pair<const Key, Value>* item_;
+
+private:
+    NodeItem(const NodeItem&);
+    NodeItem& operator=(const NodeItem&);
+};
+
+/**
+* Which search of BinarySearchTree a Key gets: the branchless one (see
+* BranchlessSearch), the prefix one for keys with a NodeKeyPrefix, or the
+* usual one.
+*/
+struct GenericSearchTag {};
+struct BranchlessSearchTag {};
+struct PrefixSearchTag {};
+
+template<typename Key>
+struct SearchTagFor
+{
+    typedef typename std::conditional<BranchlessSearch<Key>::value, BranchlessSearchTag, GenericSearchTag>::type type;
+};
+
+template<>
+struct SearchTagFor<std::string>
+{
+    typedef PrefixSearchTag type;
+};
 
 /**
  * A templated class for a Node in a search tree.
@@ -14,10 +263,10 @@
  * and AVL trees.
  */
 template <typename Key, typename Value>
-class Node
+class Node : public NodeKeyPrefix<Key>, public NodeItem<Key, Value>
 {
 public:
-    Node(const Key& key, const Value& value, Node<Key, Value>* parent);
+    Node(const Key& key, const Value& value, Node<Key, Value>* parent, TreeMemoryResource* resource = NULL);
     virtual ~Node();
 
     const std::pair<const Key, Value>& getItem() const;
@@ -29,6 +278,7 @@ public:
     virtual Node<Key, Value>* getParent() const;
     virtual Node<Key, Value>* getLeft() const;
     virtual Node<Key, Value>* getRight() const;
+    Node<Key, Value>* getChild(bool right) const;
 
     void setParent(Node<Key, Value>* parent);
     void setLeft(Node<Key, Value>* left);
@@ -36,7 +286,6 @@ public:
     void setValue(const Value &value);
 
 protected:
-    std::pair<const Key, Value> item_;
     Node<Key, Value>* parent_;
     Node<Key, Value>* left_;
     Node<Key, Value>* right_;
@@ -52,8 +301,9 @@ protected:
 * Explicit constructor for a node.
 */
 template<typename Key, typename Value>
-Node<Key, Value>::Node(const Key& key, const Value& value, Node<Key, Value>* parent) :
-    item_(key, value),
+Node<Key, Value>::Node(const Key& key, const Value& value, Node<Key, Value>* parent, TreeMemoryResource* resource) :
+    NodeKeyPrefix<Key>(key),
+    NodeItem<Key, Value>(key, value, resource != NULL ? resource : defaultTreeResource()),
     parent_(parent),
     left_(NULL),
     right_(NULL)
@@ -78,7 +328,7 @@ Node<Key, Value>::~Node()
 template<typename Key, typename Value>
 const std::pair<const Key, Value>& Node<Key, Value>::getItem() const
 {
-    return item_;
+    return this->item();
 }
 
 /**
@@ -87,7 +337,7 @@ const std::pair<const Key, Value>& Node<Key, Value>::getItem() const
 template<typename Key, typename Value>
 std::pair<const Key, Value>& Node<Key, Value>::getItem()
 {
-    return item_;
+    return this->item();
 }
 
 /**
@@ -96,7 +346,7 @@ std::pair<const Key, Value>& Node<Key, Value>::getItem()
 template<typename Key, typename Value>
 const Key& Node<Key, Value>::getKey() const
 {
-    return item_.first;
+    return this->key();
 }
 
 /**
@@ -105,7 +355,7 @@ const Key& Node<Key, Value>::getKey() const
 template<typename Key, typename Value>
 const Value& Node<Key, Value>::getValue() const
 {
-    return item_.second;
+    return this->item().second;
 }
 
 /**
@@ -114,7 +364,7 @@ const Value& Node<Key, Value>::getValue() const
 template<typename Key, typename Value>
 Value& Node<Key, Value>::getValue()
 {
-    return item_.second;
+    return this->item().second;
 }
 
 /**
@@ -144,6 +394,17 @@ Node<Key, Value>* Node<Key, Value>::getRight() const
     return right_;
 }
 
+/**
+* The left (false) or right (true) child, picked by indexing rather than by
+* a branch, so a comparison result can be used directly.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* Node<Key, Value>::getChild(bool right) const
+{
+    Node<Key, Value>* const children[2] = { left_, right_ };
+    return children[right];
+}
+
 /**
 * A setter for setting the parent of a node.
 */
@@ -177,7 +438,7 @@ void Node<Key, Value>::setRight(Node<Key, Value>* right)
 template<typename Key, typename Value>
 void Node<Key, Value>::setValue(const Value& value)
 {
-    item_.second = value;
+    this->item().second = value;
 }
 
 /*
@@ -186,6 +447,118 @@ void Node<Key, Value>::setValue(const Value& value)
   ---------------------------------------
 */
 
+/**
+* Nodes taken out of a tree in O(1) by detach_nodes(), still to be freed.
+* reclaim(budget) frees them a bit at a time, so a huge tree can be thrown
+* away without stalling anyone: each call does at most budget steps, a step
+* being freeing one node or one rotation, and the rotations never outnumber
+* the nodes. It needs no recursion or extra memory (the left children are
+* rotated up until the top node can go, then its right subtree follows).
+*
+* The object can be moved to another thread and reclaimed there (see
+* TreeReclaimer in tree-reclaimer.h); the destructor frees whatever is left.
+* Several detached trees can be put together with splice(). The memory
+* resource of the nodes must stay alive until they are freed.
+*/
+class DetachedNodes
+{
+public:
+    // Frees up to budget steps of nodes from the chain of roots starting at top, returns the nodes freed
+    typedef size_t (*ReclaimFunction)(void*& top, TreeMemoryResource* resource, size_t nodeSize, size_t nodeAlign,
+                                      size_t& budget);
+    // Puts the chain of roots starting at other in front of the one starting at top
+    typedef void (*SpliceFunction)(void*& top, void* other);
+
+    DetachedNodes() : top_(NULL), count_(0), resource_(NULL), nodeSize_(0), nodeAlign_(0), reclaim_(NULL), splice_(NULL) {}
+    DetachedNodes(void* root, size_t count, TreeMemoryResource* resource, size_t nodeSize, size_t nodeAlign,
+                  ReclaimFunction reclaim, SpliceFunction splice) :
+        top_(root), count_(root != NULL ? count : 0), resource_(resource), nodeSize_(nodeSize),
+        nodeAlign_(nodeAlign), reclaim_(reclaim), splice_(splice) {}
+    DetachedNodes(DetachedNodes&& other) noexcept :
+        top_(other.top_), count_(other.count_), resource_(other.resource_), nodeSize_(other.nodeSize_),
+        nodeAlign_(other.nodeAlign_), reclaim_(other.reclaim_), splice_(other.splice_)
+    {
+        other.top_ = NULL;
+        other.count_ = 0;
+    }
+    DetachedNodes& operator=(DetachedNodes&& other) noexcept
+    {
+        if(this != &other) {
+            reclaim();
+            top_ = other.top_;
+            count_ = other.count_;
+            resource_ = other.resource_;
+            nodeSize_ = other.nodeSize_;
+            nodeAlign_ = other.nodeAlign_;
+            reclaim_ = other.reclaim_;
+            splice_ = other.splice_;
+            other.top_ = NULL;
+            other.count_ = 0;
+        }
+        return *this;
+    }
+    ~DetachedNodes() { reclaim(); }
+
+    // Returns true once every node is freed
+    bool reclaim(size_t budget = SIZE_MAX)
+    {
+        if(top_ != NULL) {
+            size_t freed = reclaim_(top_, resource_, nodeSize_, nodeAlign_, budget);
+            count_ = (top_ == NULL) ? 0 : count_ - freed;
+        }
+        return top_ == NULL;
+    }
+    bool empty() const { return top_ == NULL; }
+    // Nodes not freed yet
+    size_t size() const { return count_; }
+
+    // Takes over other's nodes as well. If they do not come from the same kind of
+    // tree and the same memory resource, ours are freed first.
+    void splice(DetachedNodes& other)
+    {
+        if(other.top_ == NULL || this == &other) {
+            return;
+        }
+        if(top_ != NULL && (reclaim_ != other.reclaim_ || resource_ != other.resource_ ||
+                            nodeSize_ != other.nodeSize_)) {
+            reclaim();
+        }
+        if(top_ == NULL) {
+            *this = std::move(other);
+            return;
+        }
+        splice_(top_, other.top_);
+        count_ += other.count_;
+        other.top_ = NULL;
+        other.count_ = 0;
+    }
+
+private:
+    void* top_;       // the node being freed; the chain of further roots runs through its parent link
+    size_t count_;
+    TreeMemoryResource* resource_;
+    size_t nodeSize_;
+    size_t nodeAlign_;
+    ReclaimFunction reclaim_;
+    SpliceFunction splice_;
+
+    DetachedNodes(const DetachedNodes&);
+    DetachedNodes& operator=(const DetachedNodes&);
+};
+
+/**
+* The rotations, written over a node-access policy so that trees whose nodes
+* link to each other some other way than by pointer (PersistentAVLTree in
+* mmap-avlbst.h) rotate with the same code. Links::NodePtr is the node
+* handle, NULL for no node; parent(), left() and right() follow the links and
+* setParent(), setLeft(), setRight() and setRoot() change them.
+* BinarySearchTree::NodeLinks is the policy over Node pointers.
+*/
+template <typename Links>
+void rotateLeft(Links& links, typename Links::NodePtr current);
+template <typename Links>
+void rotateRight(Links& links, typename Links::NodePtr current);
+
 /**
 * A templated unbalanced binary search tree.
 */
@@ -193,14 +566,39 @@ template <typename Key, typename Value>
 class BinarySearchTree
 {
 public:
-    BinarySearchTree(); //TODO DONE
+    explicit BinarySearchTree(TreeMemoryResource* resource = NULL); //TODO DONE
+    BinarySearchTree(const BinarySearchTree<Key, Value>& other);
+    BinarySearchTree(BinarySearchTree<Key, Value>&& other) noexcept;
+    BinarySearchTree<Key, Value>& operator=(const BinarySearchTree<Key, Value>& other);
+    BinarySearchTree<Key, Value>& operator=(BinarySearchTree<Key, Value>&& other) noexcept;
     virtual ~BinarySearchTree(); //TODO DONE
     virtual void insert(const std::pair<const Key, Value>& keyValuePair); //TODO DONE
     virtual void remove(const Key& key); //TODO
-    void clear(); //TODO
+    virtual void clear(); //TODO
+    bool clear_incremental(size_t budget);
+    virtual DetachedNodes detach_nodes();
+    virtual void compact();
+    virtual void rebalance();
+    void setScapegoatAlpha(double alpha);
+    void setHashIndex(bool enabled);
+    bool hasHashIndex() const;
+    void setBloomFilter(double falsePositiveRate);
+    void rebuild_bloom_filter();
+    BloomFilterStats bloom_filter_stats() const;
     bool isBalanced() const; //TODO DONE
     void print() const;
     bool empty() const;
+    size_t size() const;
+    MemoryUsage memory_usage() const;
+    TreeMemoryResource* memory_resource() const;
+
+    // Operation counters, see TreeStats
+    TreeStats stats() const;
+    void reset_stats();
+
+    // Binary snapshots, see bst-snapshot.h for the format. load() replaces the contents.
+    void save(std::ostream& out) const;
+    void load(std::istream& in);
 
     template<typename PPKey, typename PPValue>
     friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree);
@@ -231,6 +629,14 @@ public:
     iterator begin() const;
     iterator end() const;
     iterator find(const Key& key) const;
+    void find_many(const Key* keys, size_t count, iterator* results, size_t groupSize = 16) const;
+    void find_many(const std::vector<Key>& keys, std::vector<iterator>& results, size_t groupSize = 16) const;
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    // Only there for std::string keys, K is a template parameter so other trees reject the call
+    template<typename K = Key>
+    typename std::enable_if<std::is_same<K, std::string>::value, std::pair<iterator, iterator> >::type
+    prefix_range(const std::string& prefix) const;
     Value& operator[](const Key& key);
     Value const & operator[](const Key& key) const;
 
@@ -245,18 +651,99 @@ protected:
     // Note:  static means these functions don't have a "this" pointer
     //        and instead just use the input argument.
 
+    // Lets derived trees hand out iterators, the iterator constructor is only visible to us
+    static iterator makeIterator(Node<Key, Value>* n);
+    static Node<Key, Value>* iteratorNode(const iterator& it);
+
+    // The links of this tree's nodes for rotateLeft and rotateRight
+    struct NodeLinks
+    {
+        typedef Node<Key, Value>* NodePtr;
+
+        explicit NodeLinks(BinarySearchTree<Key, Value>* tree) : tree_(tree) {}
+
+        NodePtr parent(NodePtr n) const { return n->getParent(); }
+        NodePtr left(NodePtr n) const { return n->getLeft(); }
+        NodePtr right(NodePtr n) const { return n->getRight(); }
+        void setParent(NodePtr n, NodePtr parent) { n->setParent(parent); }
+        void setLeft(NodePtr n, NodePtr left) { n->setLeft(left); }
+        void setRight(NodePtr n, NodePtr right) { n->setRight(right); }
+        void setRoot(NodePtr n) { tree_->root_ = n; }
+
+        BinarySearchTree<Key, Value>* tree_;
+    };
+
     // Provided helper functions
     virtual void printRoot (Node<Key, Value> *r) const;
     virtual void nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2) ;
+    void leftRotation(Node<Key, Value> *current);
+    void rightRotation(Node<Key, Value> *current);
 
     // Add helper functions here
+		// The searches behind internalFind and insert, one version per SearchTagFor<Key>
+		Node<Key, Value>* findNode(const Key& key, GenericSearchTag) const;
+		Node<Key, Value>* findNode(const Key& key, BranchlessSearchTag) const;
+		Node<Key, Value>* findNode(const Key& key, PrefixSearchTag) const;
+		Node<Key, Value>* findInsertPoint(const Key& key, Node<Key, Value>*& parent, Node<Key, Value>*& next) const;
+		Node<Key, Value>* findInsertPoint(const Key& key, Node<Key, Value>*& parent, Node<Key, Value>*& next, GenericSearchTag) const;
+		Node<Key, Value>* findInsertPoint(const Key& key, Node<Key, Value>*& parent, Node<Key, Value>*& next, BranchlessSearchTag) const;
+		Node<Key, Value>* findInsertPoint(const Key& key, Node<Key, Value>*& parent, Node<Key, Value>*& next, PrefixSearchTag) const;
+		// The first node with a key >= key, or > key when strict
+		Node<Key, Value>* boundNode(const Key& key, bool strict) const;
 		int height(Node<Key,Value> *r) const; //I will use this while implementing the isBalanced() function
 		void clearHelper(Node<Key, Value> *n); //This helper function is for when I am clearing the whole tree 
 
+		// Every node is created and deleted through these two, which keep size_ and the memory counts
+		template<typename NodeType>
+		NodeType* makeNode(const Key& key, const Value& value, NodeType* parent);
+		void freeNode(Node<Key, Value>* n);
+
+		// Copying: copyFrom rebuilds other's shape in this (empty) tree, node by node through
+		// cloneNode, which trees with their own node type override to keep balances/colors
+		void copyFrom(const BinarySearchTree<Key, Value>& other);
+		virtual Node<Key, Value>* cloneNode(const Node<Key, Value>* source, Node<Key, Value>* parent);
+		void stealFrom(BinarySearchTree<Key, Value>& other);
+
+		// Used by load() to build the tree without insert. Trees with their own node type
+		// override newTreeNode, and finishBuiltNode to set up their balance information.
+		virtual Node<Key, Value>* newTreeNode(const Key& key, const Value& value, Node<Key, Value>* parent);
+		virtual void finishBuiltNode(Node<Key, Value>* n, int leftHeight, int rightHeight, bool deepestLevel);
+		Node<Key, Value>* buildFromSnapshot(SnapshotReader& in, uint64_t count, int depth, int deepest, int& height);
+
+		// What DetachedNodes uses to free and join detached nodes of this tree type
+		static void destroyNode(Node<Key, Value>* n, TreeMemoryResource* resource, size_t nodeSize, size_t nodeAlign);
+		static size_t reclaimNodes(void*& top, TreeMemoryResource* resource, size_t nodeSize, size_t nodeAlign, size_t& budget);
+		static void spliceNodes(void*& top, void* other);
+
+		// compact() lays the nodes out in this order, and hands the block back with dropCompactBlock
+		void vanEmdeBoasOrder(std::vector<Node<Key, Value>*>& order) const;
+		void dropCompactBlock();
+
+		// Day-Stout-Warren rebuild of the subtree under top, returns its new top
+		Node<Key, Value>* balanceSubtree(Node<Key, Value>* top);
+		void compressVine(Node<Key, Value>* parent, bool right, size_t rotations);
+		int finishBalanced(Node<Key, Value>* n, int depth, int deepest);
+		static size_t subtreeSize(Node<Key, Value>* n);
+		void rebuildScapegoat(Node<Key, Value>* inserted);
+
 
 protected:
     Node<Key, Value>* root_;
     // You should not need other data members
+    size_t size_;
+    size_t nodeSize_;       // sizeof the node type this tree uses
+    size_t nodeAlign_;      // and its alignment
+    uint64_t usableBytes_;  // what the allocator handed out for all live nodes
+    TreeMemoryResource* resource_;
+    CompactNodeBlock* compact_;  // set after compact(), then also resource_
+    double scapegoatAlpha_;      // 0 unless setScapegoatAlpha() turned it on
+    size_t maxSize_;             // the most nodes since the last rebuild of the whole tree
+    NodeHashIndex<Key, Value>* hashIndex_;  // NULL unless setHashIndex() turned it on
+    BlockedBloomFilter<Key>* bloom_;        // NULL unless setBloomFilter() turned it on
+#ifdef BST_STATS
+    mutable TreeStats stats_;
+#endif
+    DetachedNodes pending_;  // what clear_incremental() has not freed yet
 };
 
 /*
@@ -365,16 +852,183 @@ Begin implementations for the BinarySearchTree class.
 * Default constructor for a BinarySearchTree, which sets the root to NULL.
 */
 template<class Key, class Value>
-BinarySearchTree<Key, Value>::BinarySearchTree() 
+BinarySearchTree<Key, Value>::BinarySearchTree(TreeMemoryResource* resource) 
 {
     root_=nullptr; 
+    size_=0;
+    nodeSize_=sizeof(Node<Key, Value>);
+    nodeAlign_=alignof(Node<Key, Value>);
+    usableBytes_=0;
+    resource_= resource!=nullptr ? resource : defaultTreeResource();
+    compact_=nullptr;
+    scapegoatAlpha_=0;
+    maxSize_=0;
+    hashIndex_=nullptr;
+    bloom_=nullptr;
+    reset_stats();
+}
+
+/**
+* Copy constructor, a node for node copy of other in O(n). Like the std::pmr
+* containers, the copy uses the default memory resource rather than other's,
+* so a copy of a tree in a short lived arena can outlive the arena.
+*/
+template<typename Key, typename Value>
+BinarySearchTree<Key, Value>::BinarySearchTree(const BinarySearchTree<Key, Value>& other)
+{
+    root_=nullptr;
+    size_=0;
+    nodeSize_=other.nodeSize_;
+    nodeAlign_=other.nodeAlign_;
+    usableBytes_=0;
+    resource_=defaultTreeResource();
+    compact_=nullptr;
+    scapegoatAlpha_=other.scapegoatAlpha_;
+    hashIndex_=nullptr;
+    bloom_=nullptr;
+    reset_stats();
+    copyFrom(other);
+    maxSize_=size_;
+}
+
+/**
+* Move constructor, takes over other's nodes (and memory resource) in O(1) and
+* leaves other empty. Move assignment does the same, so the nodes always stay
+* with the resource they came from; copy assignment keeps this tree's resource.
+*/
+template<typename Key, typename Value>
+BinarySearchTree<Key, Value>::BinarySearchTree(BinarySearchTree<Key, Value>&& other) noexcept
+{
+    root_=nullptr;
+    size_=0;
+    usableBytes_=0;
+    scapegoatAlpha_=other.scapegoatAlpha_;
+    hashIndex_=nullptr;
+    bloom_=nullptr;
+    reset_stats();
+    stealFrom(other);
+    maxSize_=size_;
+}
+
+template<typename Key, typename Value>
+BinarySearchTree<Key, Value>& BinarySearchTree<Key, Value>::operator=(const BinarySearchTree<Key, Value>& other)
+{
+    if(this != &other) {
+        clear();
+        scapegoatAlpha_=other.scapegoatAlpha_;
+        copyFrom(other);
+        maxSize_=size_;
+    }
+    return *this;
+}
+
+template<typename Key, typename Value>
+BinarySearchTree<Key, Value>& BinarySearchTree<Key, Value>::operator=(BinarySearchTree<Key, Value>&& other) noexcept
+{
+    if(this != &other) {
+        clear();
+        scapegoatAlpha_=other.scapegoatAlpha_;
+        stealFrom(other);
+        maxSize_=size_;
+    }
+    return *this;
 }
 
 template<typename Key, typename Value>
 BinarySearchTree<Key, Value>::~BinarySearchTree()
 {
     clear();
+    delete hashIndex_;
+    delete bloom_;
+}
+
+/**
+* Copies other's tree into this empty tree with the same shape, so nothing
+* needs rebalancing and it takes O(n). It uses a stack of nodes still to copy
+* instead of recursion, so even a degenerate (list shaped) tree is fine.
+* If an allocation fails the partial copy is removed again.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::copyFrom(const BinarySearchTree<Key, Value>& other)
+{
+	//The copy has a hash index and a Bloom filter if other has them
+	if ((hashIndex_!=nullptr)!=(other.hashIndex_!=nullptr)){
+		delete hashIndex_;
+		hashIndex_= other.hashIndex_!=nullptr ? new NodeHashIndex<Key, Value>(other.hashIndex_->hashFunction()) : nullptr;
+	}
+	delete bloom_;
+	bloom_=nullptr;
+	if (other.bloom_!=nullptr){
+		bloom_=new BlockedBloomFilter<Key>(other.bloom_->falsePositiveRate(), other.bloom_->hashFunction());
+		bloom_->reset(2*other.size_);
+	}
+	if (other.root_==nullptr){
+		return;
+	}
+	//Each entry is a node of other whose copy is made and linked, but whose children are not yet
+	std::vector<std::pair<const Node<Key, Value>*, Node<Key, Value>*> > stack;
+	try{
+		root_=cloneNode(other.root_, nullptr);
+		stack.push_back(std::make_pair(other.root_, root_));
+		while (!stack.empty()){
+			const Node<Key, Value> *source= stack.back().first;
+			Node<Key, Value> *copy= stack.back().second;
+			stack.pop_back();
+			if (source->getLeft()!=nullptr){
+				Node<Key, Value> *child= cloneNode(source->getLeft(), copy);
+				copy->setLeft(child);
+				stack.push_back(std::make_pair(source->getLeft(), child));
+			}
+			if (source->getRight()!=nullptr){
+				Node<Key, Value> *child= cloneNode(source->getRight(), copy);
+				copy->setRight(child);
+				stack.push_back(std::make_pair(source->getRight(), child));
+			}
+		}
+	}catch (...){
+		clear();
+		throw;
+	}
+}
+
+/**
+* Makes a copy of source (without its links) as a child of parent.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::cloneNode(const Node<Key, Value>* source, Node<Key, Value>* parent)
+{
+	return makeNode<Node<Key, Value> >(source->getKey(), source->getValue(), parent);
+}
 
+/**
+* Takes over other's nodes and their accounting (and hash index and Bloom
+* filter), leaving other empty and without them. This tree has to be empty already.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::stealFrom(BinarySearchTree<Key, Value>& other)
+{
+	root_=other.root_;
+	size_=other.size_;
+	nodeSize_=other.nodeSize_;
+	nodeAlign_=other.nodeAlign_;
+	usableBytes_=other.usableBytes_;
+	resource_=other.resource_;
+	compact_=other.compact_;
+	//The index and filter describe the nodes, so they go along with them
+	delete hashIndex_;
+	hashIndex_=other.hashIndex_;
+	other.hashIndex_=nullptr;
+	delete bloom_;
+	bloom_=other.bloom_;
+	other.bloom_=nullptr;
+	other.root_=nullptr;
+	other.size_=0;
+	other.usableBytes_=0;
+	//A compacted tree's block goes along with its nodes
+	if (other.compact_!=nullptr){
+		other.resource_=other.compact_->upstream();
+		other.compact_=nullptr;
+	}
 }
 
 /**
@@ -386,6 +1040,153 @@ bool BinarySearchTree<Key, Value>::empty() const
     return root_ == NULL;
 }
 
+/**
+* Returns the number of items in O(1), it is kept up to date by makeNode and freeNode.
+*/
+template<class Key, class Value>
+size_t BinarySearchTree<Key, Value>::size() const
+{
+    return size_;
+}
+
+/**
+* Returns what the tree holds in memory right now, in O(1). The slack and
+* the overhead per block come from the memory resource; for the default one
+* the overhead is the size_t header glibc's malloc puts on a block in use
+* (other C libraries report 0 here, and no slack).
+*/
+template<class Key, class Value>
+MemoryUsage BinarySearchTree<Key, Value>::memory_usage() const
+{
+	MemoryUsage usage;
+	usage.nodes=size_;
+	usage.nodeBytes=static_cast<uint64_t>(size_)*(nodeSize_+Node<Key, Value>::kColdBytes);
+	usage.slackBytes=usableBytes_-usage.nodeBytes;
+	//One block per node, two when the values are kept out of line
+	usage.overheadBytes=static_cast<uint64_t>(size_)*resource_->block_overhead()*(Node<Key, Value>::kColdBytes!=0 ? 2 : 1);
+	usage.treeBytes=sizeof(*this);
+	usage.indexBytes= (hashIndex_!=nullptr ? hashIndex_->bytes() : 0)+(bloom_!=nullptr ? bloom_->bytes() : 0);
+	return usage;
+}
+
+/**
+* Allocates and constructs a node of the tree's node type from the tree's
+* memory resource. All nodes of a tree have the same type, so nodeSize_ and
+* nodeAlign_ stay the same after the first one.
+*/
+template<class Key, class Value>
+template<typename NodeType>
+NodeType* BinarySearchTree<Key, Value>::makeNode(const Key& key, const Value& value, NodeType* parent)
+{
+	//Every node made so far is linked into the tree (load() fills the filter itself), so it can
+	//be rebuilt from them
+	if (bloom_!=nullptr && bloom_->full()){
+		rebuild_bloom_filter();
+	}
+	void* memory= resource_->allocate(sizeof(NodeType), alignof(NodeType));
+	NodeType* n;
+	try{
+		n= new (memory) NodeType(key, value, parent, resource_);
+	}catch (...){
+		resource_->deallocate(memory, sizeof(NodeType), alignof(NodeType));
+		throw;
+	}
+	if (hashIndex_!=nullptr){
+		try{
+			hashIndex_->insert(n);
+		}catch (...){
+			destroyNode(n, resource_, sizeof(NodeType), alignof(NodeType));
+			throw;
+		}
+	}
+	if (bloom_!=nullptr){
+		bloom_->add(key);
+	}
+	nodeSize_=sizeof(NodeType);
+	nodeAlign_=alignof(NodeType);
+	usableBytes_+=resource_->usable_size(memory, sizeof(NodeType));
+	if (n->coldBlock()!=NULL){
+		usableBytes_+=resource_->usable_size(n->coldBlock(), Node<Key, Value>::kColdBytes);
+	}
+	++size_;
+	BST_COUNT(allocations, 1);
+	return n;
+}
+
+/**
+* Destroys and frees a node made by makeNode. The caller unlinks it first.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::freeNode(Node<Key, Value>* n)
+{
+	if (hashIndex_!=nullptr){
+		hashIndex_->erase(n);
+	}
+	usableBytes_-=resource_->usable_size(n, nodeSize_);
+	if (n->coldBlock()!=NULL){
+		usableBytes_-=resource_->usable_size(n->coldBlock(), Node<Key, Value>::kColdBytes);
+	}
+	--size_;
+	destroyNode(n, resource_, nodeSize_, nodeAlign_);
+	BST_COUNT(deallocations, 1);
+	//The key's bits stay in the filter. Rebuilding here instead of waiting for inserts to fill
+	//it keeps the stale bits bounded for a tree that mostly shrinks and for the reads after that.
+	//n is unlinked already, so the rest of the tree is whole.
+	if (bloom_!=nullptr){
+		bloom_->noteRemoved();
+		if (bloom_->stale()){
+			try{
+				rebuild_bloom_filter();
+			}catch (...){
+				//Out of memory: the old filter stays, it only lets more missing keys through
+			}
+		}
+	}
+}
+
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::destroyNode(Node<Key, Value>* n, TreeMemoryResource* resource, size_t nodeSize, size_t nodeAlign)
+{
+	n->releaseItem(resource);
+	n->~Node();
+	resource->deallocate(n, nodeSize, nodeAlign);
+}
+
+/**
+* The memory resource the nodes come from. After compact() that is still the
+* resource the tree was given, which the compact block takes its memory from.
+*/
+template<class Key, class Value>
+TreeMemoryResource* BinarySearchTree<Key, Value>::memory_resource() const
+{
+	return compact_!=nullptr ? compact_->upstream() : resource_;
+}
+
+/**
+* Returns a snapshot of the operation counters (all zero unless built with BST_STATS).
+*/
+template<class Key, class Value>
+TreeStats BinarySearchTree<Key, Value>::stats() const
+{
+#ifdef BST_STATS
+    return stats_;
+#else
+    TreeStats none = TreeStats();
+    return none;
+#endif
+}
+
+/**
+* Sets all operation counters back to zero.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::reset_stats()
+{
+#ifdef BST_STATS
+    stats_ = TreeStats();
+#endif
+}
+
 template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::print() const
 {
@@ -423,28 +1224,330 @@ template<class Key, class Value>
 typename BinarySearchTree<Key, Value>::iterator
 BinarySearchTree<Key, Value>::find(const Key & k) const
 {
+    BST_COUNT(operations, 1);
     Node<Key, Value> *curr = internalFind(k);
     BinarySearchTree<Key, Value>::iterator it(curr);
     return it;
 }
 
 /**
- * @precondition The key exists in the map
- * Returns the value associated with the key
- */
+* Looks up count keys at once and stores an iterator for each (end() if missing)
+* in results. A single find waits for a cache miss at every level. Here a group
+* of up to 32 lookups advances in lockstep, one level each per round, and the
+* next node of every lookup is prefetched when it is chosen. By the time the
+* round comes back to a lookup its node is usually in cache, so the misses of
+* the whole group overlap instead of adding up.
+*/
 template<class Key, class Value>
-Value& BinarySearchTree<Key, Value>::operator[](const Key& key)
+void BinarySearchTree<Key, Value>::find_many(const Key* keys, size_t count, iterator* results, size_t groupSize) const
 {
-    Node<Key, Value> *curr = internalFind(key);
-    if(curr == NULL) throw std::out_of_range("Invalid key");
-    return curr->getValue();
+	static const size_t kMaxGroup = 32;
+	if (groupSize<1){
+		groupSize=1;
+	}else if (groupSize>kMaxGroup){
+		groupSize=kMaxGroup;
+	}
+	BST_COUNT(operations, count);
+
+	Node<Key, Value>* current[kMaxGroup];
+	size_t slotKey[kMaxGroup]; //Which key each slot of the group is working on
+	size_t nextKey=0;
+	size_t active=0;
+
+	//Fill the group
+	for (; active<groupSize && nextKey<count; ++active, ++nextKey){
+		current[active]=root_;
+		slotKey[active]=nextKey;
+	}
+
+	while (active>0){
+		for (size_t i=0; i<active; ){
+			Node<Key, Value>* node=current[i];
+			const Key& key=keys[slotKey[i]];
+			bool done=(node==nullptr);
+			if (!done){
+				BST_COUNT(nodesVisited, 1);
+				BST_COUNT(comparisons, 1);
+				if (node->getKey()==key){
+					done=true;
+				}else{
+					BST_COUNT(comparisons, 1);
+					node= (key<node->getKey()) ? node->getLeft() : node->getRight();
+					if (node!=nullptr){
+						BST_PREFETCH(node, sizeof(Node<Key, Value>));
+					}
+					current[i]=node;
+					done=(node==nullptr);
+				}
+			}
+			if (!done){
+				++i;
+				continue;
+			}
+
+			//This lookup is finished, the slot takes the next key or is closed
+			results[slotKey[i]]=iterator(node);
+			if (nextKey<count){
+				current[i]=root_;
+				slotKey[i]=nextKey++;
+				++i;
+			}else{
+				--active;
+				current[i]=current[active];
+				slotKey[i]=slotKey[active];
+			}
+		}
+	}
 }
+
+/**
+* Vector version of find_many, results is resized to match keys.
+*/
 template<class Key, class Value>
-Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
+void BinarySearchTree<Key, Value>::find_many(const std::vector<Key>& keys, std::vector<iterator>& results, size_t groupSize) const
 {
-    Node<Key, Value> *curr = internalFind(key);
-    if(curr == NULL) throw std::out_of_range("Invalid key");
-    return curr->getValue();
+	results.resize(keys.size());
+	if (!keys.empty()){
+		find_many(&keys[0], keys.size(), &results[0], groupSize);
+	}
+}
+
+/**
+* An iterator to the first item whose key is not smaller than key, end() if there is none.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::lower_bound(const Key& key) const
+{
+	BST_COUNT(operations, 1);
+	return iterator(boundNode(key, false));
+}
+
+/**
+* An iterator to the first item whose key is larger than key, end() if there is none.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::upper_bound(const Key& key) const
+{
+	BST_COUNT(operations, 1);
+	return iterator(boundNode(key, true));
+}
+
+/**
+* For std::string keys only: the range [first, second) of the items whose key
+* starts with prefix. It ends at the lower bound of the smallest string past
+* every key with the prefix, which is the prefix with its last character (not
+* counting trailing 0xff ones) incremented.
+*/
+template<class Key, class Value>
+template<typename K>
+typename std::enable_if<std::is_same<K, std::string>::value,
+    std::pair<typename BinarySearchTree<Key, Value>::iterator, typename BinarySearchTree<Key, Value>::iterator> >::type
+BinarySearchTree<Key, Value>::prefix_range(const std::string& prefix) const
+{
+	std::string past= prefix;
+	while (!past.empty() && static_cast<unsigned char>(past[past.size()-1])==0xff){
+		past.erase(past.size()-1);
+	}
+	iterator last= end();
+	if (!past.empty()){
+		past[past.size()-1]= static_cast<char>(static_cast<unsigned char>(past[past.size()-1])+1);
+		last= lower_bound(past);
+	}
+	return std::make_pair(lower_bound(prefix), last);
+}
+
+/**
+* Writes the tree to out: a header and then the entries in key order, which
+* is all load() needs to rebuild the same set of entries.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::save(std::ostream& out) const
+{
+	uint64_t count=size_;
+	SnapshotWriter writer(out);
+	writer.write(kSnapshotMagic, sizeof(kSnapshotMagic));
+	writer.writeRaw(kSnapshotVersion);
+	writer.writeRaw(static_cast<uint32_t>(BSTSerializer<Key>::kRawSize));
+	writer.writeRaw(static_cast<uint32_t>(BSTSerializer<Value>::kRawSize));
+	writer.writeRaw(count);
+
+	//A stack instead of the iterator, whose successor() steps climb back up through
+	//the parents. On a large tree that is about twice as many cache misses.
+	std::vector<Node<Key, Value>*> stack;
+	Node<Key, Value> *n= root_;
+	while (n!=nullptr || !stack.empty()){
+		for (; n!=nullptr; n=n->getLeft()){
+			stack.push_back(n);
+		}
+		n=stack.back();
+		stack.pop_back();
+		BSTSerializer<Key>::write(writer, n->getKey());
+		BSTSerializer<Value>::write(writer, n->getValue());
+		n=n->getRight();
+	}
+	writer.flush();
+}
+
+/**
+* Replaces the contents with a snapshot written by save(). The entries come
+* sorted, so the tree is built directly in O(n) without insert: every subtree
+* gets half of the remaining entries and the nodes are created in key order
+* while the entries stream in. The result is as balanced as a tree of that
+* size can be. A bad or truncated snapshot throws std::runtime_error and
+* leaves the tree empty.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::load(std::istream& in)
+{
+	clear();
+
+	SnapshotReader reader(in);
+	char magic[sizeof(kSnapshotMagic)];
+	uint32_t version, keySize, valueSize;
+	uint64_t count;
+	reader.read(magic, sizeof(magic));
+	reader.readRaw(version);
+	if (memcmp(magic, kSnapshotMagic, sizeof(magic))!=0 || version!=kSnapshotVersion){
+		throw std::runtime_error("not a tree snapshot");
+	}
+	reader.readRaw(keySize);
+	reader.readRaw(valueSize);
+	if (keySize!=BSTSerializer<Key>::kRawSize || valueSize!=BSTSerializer<Value>::kRawSize){
+		throw std::runtime_error("tree snapshot was written for different key or value types");
+	}
+	reader.readRaw(count);
+
+	//Depth of the deepest level, the tree has floor(log2(count))+1 levels
+	int deepest=0;
+	for (uint64_t c=count; c>1; c>>=1){
+		++deepest;
+	}
+	int height;
+	//The nodes are only linked into the tree at the end, so the filter is filled after that
+	BlockedBloomFilter<Key>* filter=bloom_;
+	bloom_=nullptr;
+	try{
+		root_=buildFromSnapshot(reader, count, 0, deepest, height);
+	}catch (...){
+		bloom_=filter;
+		throw;
+	}
+	bloom_=filter;
+	if (bloom_!=nullptr){
+		try{
+			rebuild_bloom_filter();
+		}catch (...){
+			clear();
+			throw;
+		}
+	}
+	reader.finish();
+}
+
+/**
+* Builds a subtree from the next count entries and returns its root. The
+* left half is built first since its entries come first. If reading fails
+* the nodes built so far are deleted before the exception moves on.
+*/
+template<class Key, class Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::buildFromSnapshot(SnapshotReader& in, uint64_t count, int depth, int deepest, int& height)
+{
+	if (count==0){
+		height=0;
+		return nullptr;
+	}
+	uint64_t leftCount=(count-1)/2;
+	int leftHeight, rightHeight;
+	Node<Key, Value> *left= buildFromSnapshot(in, leftCount, depth+1, deepest, leftHeight);
+
+	Node<Key, Value> *n;
+	try{
+		Key key;
+		Value value;
+		BSTSerializer<Key>::read(in, key);
+		BSTSerializer<Value>::read(in, value);
+		n=newTreeNode(key, value, nullptr);
+	}catch (...){
+		clearHelper(left);
+		throw;
+	}
+	n->setLeft(left);
+	if (left!=nullptr){
+		left->setParent(n);
+	}
+
+	Node<Key, Value> *right;
+	try{
+		right=buildFromSnapshot(in, count-1-leftCount, depth+1, deepest, rightHeight);
+	}catch (...){
+		clearHelper(n);
+		throw;
+	}
+	n->setRight(right);
+	if (right!=nullptr){
+		right->setParent(n);
+	}
+
+	finishBuiltNode(n, leftHeight, rightHeight, depth==deepest && depth>0);
+	height=1+std::max(leftHeight, rightHeight);
+	return n;
+}
+
+template<class Key, class Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::newTreeNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+	return makeNode<Node<Key, Value> >(key, value, parent);
+}
+
+/**
+* The plain tree keeps no balance information, so there is nothing to do.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::finishBuiltNode(Node<Key, Value>*, int, int, bool)
+{
+
+}
+
+/**
+* Wraps a node pointer (or NULL for end()) in an iterator.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::makeIterator(Node<Key, Value>* n)
+{
+    return iterator(n);
+}
+
+/**
+* Returns the node an iterator points to (NULL for end()).
+*/
+template<class Key, class Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::iteratorNode(const iterator& it)
+{
+    return it.current_;
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value>
+Value& BinarySearchTree<Key, Value>::operator[](const Key& key)
+{
+    BST_COUNT(operations, 1);
+    Node<Key, Value> *curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+template<class Key, class Value>
+Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
+{
+    BST_COUNT(operations, 1);
+    Node<Key, Value> *curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
 }
 
 /**
@@ -456,15 +1559,18 @@ Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
 template<class Key, class Value>
 void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
 {
+	BST_COUNT(operations, 1);
 
 	//CASE 1: If the tree is EMPTY, we set a new root
 	if (root_==NULL){
-		root_=new Node<Key,Value>(keyValuePair.first, keyValuePair.second, nullptr); //setting the parent as nullptr
+		root_=makeNode<Node<Key,Value> >(keyValuePair.first, keyValuePair.second, nullptr); //setting the parent as nullptr
 	}
 
 	//CASE 2: If KEY is already in the tree, we will find it and update it's value
 	else{
-		Node<Key,Value> *found= internalFind(keyValuePair.first); 
+		Node<Key, Value> *parent= nullptr; //this is going to be the parent of the new node
+		Node<Key, Value> *next= nullptr;
+		Node<Key,Value> *found= findInsertPoint(keyValuePair.first, parent, next); 
 		if (found!=nullptr){ //If KEY found
 			found->setValue(keyValuePair.second); //Updating the VALUE
 		}
@@ -472,24 +1578,11 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
 		//CASE 3: If the KEY doesn't already exist we insert normally
 		else{ 
 
-				Node<Key, Value> *temp= root_; //We can access the root itself
-				Node<Key, Value> *parent= nullptr; //this is going to be our parent that updates as we go through the tree
-
 				const Key& keyNew=keyValuePair.first; //This is our new KEY to insert
 				const Value& valueNew=keyValuePair.second; //This is our new VALUE to insert
 
-				while (temp!= NULL){ 
-					parent=temp; //move down
-					if(keyNew>temp->getKey()){ //If the new KEY is greater than the temporary one, calling the getter on the actual node
-						temp=temp->getRight(); //We move to the right
-					}
-					else if (keyNew< temp->getKey()){ //If the new KEY is smaller than the temporary one, 
-						temp=temp->getLeft(); //We move left
-					}
-				}
-
 				//This is where we reached the leaf node to insert, we found where we are going to insert
-				Node<Key, Value> *toInsert= new Node<Key, Value>(keyNew, valueNew, parent); 
+				Node<Key, Value> *toInsert= makeNode<Node<Key, Value> >(keyNew, valueNew, parent); 
 
 				//Checking whether we should insert it to the left or right of the parent
 				if(keyNew<parent->getKey()){
@@ -497,8 +1590,12 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
 				}else{
 					parent->setRight(toInsert);
 				}
+				if (scapegoatAlpha_>0){
+					rebuildScapegoat(toInsert);
+				}
 		}
 	}
+	maxSize_=std::max(maxSize_, size_);
 }
 
 
@@ -511,6 +1608,7 @@ template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::remove(const Key& key)
 {
     // TODO
+	BST_COUNT(operations, 1);
 	//Using our helper function to locate the key
 	Node<Key,Value> *found= internalFind(key); 
 
@@ -586,7 +1684,12 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
 		}
 
   }
-	delete found; //We delete our found key
+	freeNode(found); //We delete our found key
+
+	//In scapegoat mode, rebuild everything once a good part of the nodes is gone
+	if (scapegoatAlpha_>0 && size_<scapegoatAlpha_*maxSize_){
+		rebalance();
+	}
 }
 
 
@@ -673,14 +1776,566 @@ BinarySearchTree<Key, Value>::successor(Node<Key, Value>* current)
 template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::clear()
 {
-    //In order to avoid dangling pointers we have to do post-order tree traversal, deleting the subtrees first
-		//To do this, I will use a helper function
-		clearHelper(root_); 
-		root_=nullptr; //Re-setting the root node for future use of the tree, avoiding dangling pointers
+		//The nodes leave the tree in O(1) and are freed right away, iteratively so that even a
+		//degenerate tree does not run out of stack. Leftovers of clear_incremental() go too.
+		DetachedNodes nodes= detach_nodes();
+		nodes.reclaim();
+		pending_.reclaim();
+}		
 
-		
+/**
+* Empties the tree like clear(), but frees the nodes a bit at a time: each
+* call does at most budget steps of the work (see DetachedNodes) and returns
+* true once all of it is done. The tree is empty and can be used again as soon
+* as the first call returns; if it is filled and cleared again meanwhile, the
+* new nodes join the ones still waiting. Nodes still waiting are not counted
+* by memory_usage(), and the destructor or clear() frees them.
+*/
+template<typename Key, typename Value>
+bool BinarySearchTree<Key, Value>::clear_incremental(size_t budget)
+{
+	if (root_!=nullptr){
+		DetachedNodes nodes= detach_nodes();
+		pending_.splice(nodes);
+	}
+	return pending_.reclaim(budget);
+}
 
-}		
+/**
+* Takes every node out of the tree in O(1) and hands them over, so they can be
+* freed later or on another thread (see TreeReclaimer). The tree is empty and
+* ready for use right away.
+*/
+template<typename Key, typename Value>
+DetachedNodes BinarySearchTree<Key, Value>::detach_nodes()
+{
+	DetachedNodes nodes(root_, size_, resource_, nodeSize_, nodeAlign_, &reclaimNodes, &spliceNodes);
+	BST_COUNT(deallocations, size_);
+	root_=nullptr;
+	size_=0;
+	usableBytes_=0;
+	if (hashIndex_!=nullptr){
+		hashIndex_->clear();
+	}
+	if (bloom_!=nullptr){
+		bloom_->clear();
+	}
+	//The nodes still free themselves through the compact block, which goes after the last one
+	dropCompactBlock();
+	return nodes;
+}
+
+/**
+* Moves every node into one contiguous block, in van Emde Boas order: the
+* top half of the levels is laid out first (recursively in the same order),
+* then each subtree hanging below it. Whatever the tree's height, a search
+* then touches O(log_B n) cache lines or pages of B nodes each, without
+* knowing B, and the memory scattered by many inserts and removes is given
+* back. O(n): finding the order walks the top half of each subtree again,
+* which adds up to a constant times n (see vanEmdeBoasOrder).
+*
+* The new tree is built next to the old one and only takes its place once it
+* is complete, so it needs the memory of a second copy of the nodes while it
+* runs. If copying a key or value throws, the copy is freed and the tree is
+* left as it was.
+*
+* Meant for a quiet moment: all iterators are invalidated. Later inserts reuse
+* the slots of removed nodes first; once the block is full they come from the
+* tree's memory resource as usual. Calling it again relays out everything.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::compact()
+{
+	if (root_==nullptr){
+		return;
+	}
+	std::vector<Node<Key, Value>*> order;
+	order.reserve(size_);
+	vanEmdeBoasOrder(order);
+	std::vector<Node<Key, Value>*> parents(order.size());
+	for (size_t i=0; i<order.size(); ++i){
+		parents[i]=order[i]->getParent();
+	}
+	CompactNodeBlock* block= new CompactNodeBlock(size_, nodeSize_, nodeAlign_, memory_resource());
+
+	//cloneNode makes its nodes like an insert would, so for now the tree looks like an empty one
+	//using the block, without index or filter. Its own state comes back afterwards.
+	TreeMemoryResource* oldResource= resource_;
+	size_t oldSize= size_;
+	uint64_t oldUsableBytes= usableBytes_;
+	NodeHashIndex<Key, Value>* index= hashIndex_;
+	BlockedBloomFilter<Key>* filter= bloom_;
+	resource_=block;
+	size_=0;
+	usableBytes_=0;
+	hashIndex_=nullptr;
+	bloom_=nullptr;
+	//Every parent comes before its children in the order. Once a node is copied, its own parent
+	//link (saved in parents) remembers the copy for its children.
+	size_t copied=0;
+	try{
+		for (; copied<order.size(); ++copied){
+			Node<Key, Value> *old= order[copied];
+			Node<Key, Value> *oldParent= parents[copied];
+			Node<Key, Value> *parent= oldParent!=nullptr ? oldParent->getParent() : nullptr;
+			Node<Key, Value> *copy= cloneNode(old, parent);
+			if (oldParent!=nullptr){
+				if (oldParent->getLeft()==old){
+					parent->setLeft(copy);
+				}else{
+					parent->setRight(copy);
+				}
+			}
+			old->setParent(copy);
+		}
+	}catch (...){
+		for (size_t i=0; i<copied; ++i){
+			Node<Key, Value> *copy= order[i]->getParent();
+			order[i]->setParent(parents[i]);
+			destroyNode(copy, block, nodeSize_, nodeAlign_);
+		}
+		BST_COUNT(deallocations, copied);
+		resource_=oldResource;
+		size_=oldSize;
+		usableBytes_=oldUsableBytes;
+		hashIndex_=index;
+		bloom_=filter;
+		block->release();
+		throw;
+	}
+
+	//The copy is complete, it takes the old nodes' place
+	hashIndex_=index;
+	bloom_=filter;
+	root_=order[0]->getParent();
+	if (hashIndex_!=nullptr){
+		hashIndex_->clear();
+	}
+	if (bloom_!=nullptr){
+		//Which also drops what removes left in the filter
+		bloom_->clear();
+	}
+	for (size_t i=0; i<order.size(); ++i){
+		Node<Key, Value> *copy= order[i]->getParent();
+		//Neither grows: the index and filter held this many keys before
+		if (hashIndex_!=nullptr){
+			hashIndex_->insert(copy);
+		}
+		if (bloom_!=nullptr){
+			bloom_->add(copy->getKey());
+		}
+		destroyNode(order[i], oldResource, nodeSize_, nodeAlign_);
+	}
+	BST_COUNT(deallocations, order.size());
+	if (compact_!=nullptr){
+		compact_->release();
+	}
+	compact_=block;
+}
+
+/**
+* Fills order with the nodes in van Emde Boas order, without recursion. A
+* piece of work is a node and a number of levels below it: the top half of
+* those levels is laid out first, then the subtrees rooted on the level
+* after it, left to right.
+*
+* Finding those subtrees walks the top half of a piece again, about the
+* square root of its nodes, and each level of the recursion takes the
+* square root once more. In a balanced tree the walks add up to n times a
+* sum that converges, so the whole order takes O(n).
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::vanEmdeBoasOrder(std::vector<Node<Key, Value>*>& order) const
+{
+	std::vector<std::pair<Node<Key, Value>*, int> > walk;
+	int levels=0;
+	walk.push_back(std::make_pair(root_, 1));
+	while (!walk.empty()){
+		Node<Key, Value> *n= walk.back().first;
+		int depth= walk.back().second;
+		walk.pop_back();
+		levels=std::max(levels, depth);
+		if (n->getLeft()!=nullptr) walk.push_back(std::make_pair(n->getLeft(), depth+1));
+		if (n->getRight()!=nullptr) walk.push_back(std::make_pair(n->getRight(), depth+1));
+	}
+
+	std::vector<std::pair<Node<Key, Value>*, int> > work;
+	std::vector<Node<Key, Value>*> bottoms;
+	work.push_back(std::make_pair(root_, levels));
+	while (!work.empty()){
+		Node<Key, Value> *n= work.back().first;
+		int height= work.back().second;
+		work.pop_back();
+		if (height==1 || (n->getLeft()==nullptr && n->getRight()==nullptr)){
+			order.push_back(n);
+			continue;
+		}
+		int top= height/2;
+		//Find the roots of the bottom subtrees, top levels below n, from left to right
+		bottoms.clear();
+		walk.push_back(std::make_pair(n, 0));
+		while (!walk.empty()){
+			Node<Key, Value> *m= walk.back().first;
+			int depth= walk.back().second;
+			walk.pop_back();
+			if (depth==top){
+				bottoms.push_back(m);
+				continue;
+			}
+			if (m->getRight()!=nullptr) walk.push_back(std::make_pair(m->getRight(), depth+1));
+			if (m->getLeft()!=nullptr) walk.push_back(std::make_pair(m->getLeft(), depth+1));
+		}
+		//Pushed in reverse so the top comes off first, then the bottoms left to right
+		for (size_t i=bottoms.size(); i-- > 0;){
+			work.push_back(std::make_pair(bottoms[i], height-top));
+		}
+		work.push_back(std::make_pair(n, top));
+	}
+}
+
+/**
+* Rebuilds the whole tree perfectly balanced in O(n) with no extra memory (see
+* balanceSubtree), for instance after the plain tree got sorted input. Every
+* level but the last is full afterwards. AVL balances and red-black colors are
+* set again the way load() sets them, so it works on every tree type, and
+* iterators stay valid.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::rebalance()
+{
+	maxSize_=size_;
+	if (root_==nullptr){
+		return;
+	}
+	balanceSubtree(root_);
+	//Depth of the deepest level, the tree has floor(log2(size))+1 levels like after load()
+	int deepest=0;
+	for (size_t c=size_; c>1; c>>=1){
+		++deepest;
+	}
+	finishBalanced(root_, 0, deepest);
+}
+
+/**
+* Turns on scapegoat balancing for the plain BinarySearchTree, alpha between
+* 0.5 and 1 (0 turns it off again). When an insert leaves the new node deeper
+* than log base 1/alpha of the size, the ancestor whose one subtree got more
+* than alpha of its nodes, the scapegoat, is rebuilt perfectly balanced, and
+* when removes shrink the tree below alpha times its largest size the whole
+* tree is. That gives O(log n) amortized inserts and removes and O(log n)
+* searches with no balance information in the nodes; a smaller alpha keeps the
+* tree flatter at the price of more rebuilding. AVL, red-black and splay trees
+* have their own insert and remove and are not affected.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::setScapegoatAlpha(double alpha)
+{
+	if (alpha!=0 && (alpha<0.5 || alpha>=1)){
+		throw std::invalid_argument("scapegoat alpha must be in [0.5, 1)");
+	}
+	scapegoatAlpha_=alpha;
+	if (alpha!=0){
+		rebalance();
+	}
+}
+
+/**
+* Keeps a hash index from key to node next to the tree (see NodeHashIndex),
+* so find(), operator[] and the search at the start of remove() take O(1)
+* instead of O(log n); iteration, lower_bound and the other range queries
+* still walk the tree. Turning it on indexes the existing nodes in O(n).
+* It costs 16 to 32 bytes per node (see memory_usage()) plus a hash of the
+* key on every insert and remove, and needs std::hash<Key> and operator==.
+* Copies of the tree get an index too. The splay tree's own find() keeps
+* splaying and does not use it.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::setHashIndex(bool enabled)
+{
+	if (!enabled){
+		delete hashIndex_;
+		hashIndex_=nullptr;
+		return;
+	}
+	if (hashIndex_!=nullptr){
+		return;
+	}
+	NodeHashIndex<Key, Value>* index= new NodeHashIndex<Key, Value>(&stdHashKey<Key>);
+	try{
+		for (Node<Key, Value>* n= getSmallestNode(); n!=nullptr; n=successor(n)){
+			index->insert(n);
+		}
+	}catch (...){
+		delete index;
+		throw;
+	}
+	hashIndex_=index;
+}
+
+template<typename Key, typename Value>
+bool BinarySearchTree<Key, Value>::hasHashIndex() const
+{
+	return hashIndex_!=nullptr;
+}
+
+/**
+* Puts a blocked Bloom filter (see BlockedBloomFilter) in front of the tree,
+* so that find(), operator[] and remove() give up on most missing keys after
+* one or two cache lines instead of a walk down to a leaf. falsePositiveRate
+* is the share of missing keys the filter lets through to the search; 0.01
+* takes about 1.2 bytes per key, twice that right after a rebuild, and every
+* tenth of that rate about 0.6 more. 0 turns the filter off again.
+*
+* Inserts add their key. Removes leave theirs behind, so when the filter has
+* taken as many keys as it was sized for, removed ones included, the next
+* insert rebuilds it from the tree's nodes for twice the size, in O(n). A
+* remove rebuilds it too once half as many keys as it was built with have
+* left, so trees that mostly remove do not keep the stale bits.
+* bloom_filter_stats() reports the false positive rate it has right now;
+* rebuild_bloom_filter() drops what removes left behind early. Needs
+* std::hash<Key>; copies get a filter too, and a splay tree's own find()
+* does not use it.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::setBloomFilter(double falsePositiveRate)
+{
+	if (falsePositiveRate<0 || falsePositiveRate>=1){
+		throw std::invalid_argument("Bloom filter false positive rate must be in [0, 1)");
+	}
+	delete bloom_;
+	bloom_=nullptr;
+	if (falsePositiveRate==0){
+		return;
+	}
+	bloom_=new BlockedBloomFilter<Key>(falsePositiveRate, &stdHashKey<Key>);
+	try{
+		rebuild_bloom_filter();
+	}catch (...){
+		delete bloom_;
+		bloom_=nullptr;
+		throw;
+	}
+}
+
+/**
+* Empties the filter, sizes it for twice the tree and adds every key again.
+* If that runs out of memory the old filter stays as it was.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::rebuild_bloom_filter()
+{
+	if (bloom_==nullptr){
+		return;
+	}
+	bloom_->reset(2*size_);
+	for (Node<Key, Value>* n= getSmallestNode(); n!=nullptr; n=successor(n)){
+		bloom_->add(n->getKey());
+	}
+}
+
+template<typename Key, typename Value>
+BloomFilterStats BinarySearchTree<Key, Value>::bloom_filter_stats() const
+{
+	if (bloom_==nullptr){
+		BloomFilterStats none= {0, 0, 0, 0, 0, 0, 0, 0};
+		return none;
+	}
+	return bloom_->stats();
+}
+
+/**
+* Day-Stout-Warren: the subtree is first turned into a vine, a list of right
+* children, by rotating every left child up. Then a round of left rotations on
+* every other vine node leaves a full tree's worth of nodes in the vine (the
+* rest becomes the partial last level), and rounds that each halve the vine
+* fold it into a balanced tree. O(n) rotations and no extra memory.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::balanceSubtree(Node<Key, Value>* top)
+{
+	Node<Key, Value> *parent= top->getParent();
+	bool right= parent!=nullptr && parent->getRight()==top;
+
+	size_t count=0;
+	Node<Key, Value> *n= top;
+	while (n!=nullptr){
+		Node<Key, Value> *left= n->getLeft();
+		if (left!=nullptr){
+			rightRotation(n);
+			n=left;
+		}else{
+			++count;
+			n=n->getRight();
+		}
+	}
+
+	//The largest 2^k-1 nodes that fit
+	size_t full=1;
+	while (2*full+1<=count){
+		full=2*full+1;
+	}
+	compressVine(parent, right, count-full);
+	while (full>1){
+		full/=2;
+		compressVine(parent, right, full);
+	}
+	return parent!=nullptr ? parent->getChild(right) : root_;
+}
+
+/**
+* Left rotates the first rotations nodes on every other step down the vine
+* hanging from parent (from the root if parent is NULL).
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::compressVine(Node<Key, Value>* parent, bool right, size_t rotations)
+{
+	Node<Key, Value> *n= parent!=nullptr ? parent->getChild(right) : root_;
+	for (size_t i=0; i<rotations; ++i){
+		leftRotation(n);
+		n=n->getParent()->getRight();
+	}
+}
+
+/**
+* Lets trees with their own node type fix up a freshly balanced tree through
+* finishBuiltNode, like load() does. Returns the height under n; the tree is
+* balanced, so the recursion is only O(log n) deep.
+*/
+template<typename Key, typename Value>
+int BinarySearchTree<Key, Value>::finishBalanced(Node<Key, Value>* n, int depth, int deepest)
+{
+	if (n==nullptr){
+		return 0;
+	}
+	int leftHeight= finishBalanced(n->getLeft(), depth+1, deepest);
+	int rightHeight= finishBalanced(n->getRight(), depth+1, deepest);
+	finishBuiltNode(n, leftHeight, rightHeight, depth==deepest && depth>0);
+	return 1+std::max(leftHeight, rightHeight);
+}
+
+/**
+* Counts the nodes under n without recursion.
+*/
+template<typename Key, typename Value>
+size_t BinarySearchTree<Key, Value>::subtreeSize(Node<Key, Value>* n)
+{
+	size_t count=0;
+	std::vector<Node<Key, Value>*> stack;
+	if (n!=nullptr){
+		stack.push_back(n);
+	}
+	while (!stack.empty()){
+		Node<Key, Value> *m= stack.back();
+		stack.pop_back();
+		++count;
+		if (m->getLeft()!=nullptr) stack.push_back(m->getLeft());
+		if (m->getRight()!=nullptr) stack.push_back(m->getRight());
+	}
+	return count;
+}
+
+/**
+* The scapegoat step after inserting the node inserted. If it went too deep,
+* walk up adding up subtree sizes (a sibling subtree has to be counted) until
+* an ancestor is found whose child on the way holds more than alpha of its
+* nodes, and rebuild that ancestor's subtree. The counting is paid for by the
+* inserts since the subtree was last rebuilt, so it is O(log n) amortized.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::rebuildScapegoat(Node<Key, Value>* inserted)
+{
+	size_t depth=0;
+	for (Node<Key, Value> *n= inserted->getParent(); n!=nullptr; n=n->getParent()){
+		++depth;
+	}
+	if (depth<=std::log(static_cast<double>(size_))/std::log(1/scapegoatAlpha_)){
+		return;
+	}
+	Node<Key, Value> *child= inserted;
+	size_t childSize=1;
+	for (Node<Key, Value> *n= inserted->getParent(); n!=nullptr; n=n->getParent()){
+		Node<Key, Value> *sibling= n->getLeft()==child ? n->getRight() : n->getLeft();
+		size_t size= childSize+1+subtreeSize(sibling);
+		if (childSize>scapegoatAlpha_*size){
+			if (n==root_){
+				maxSize_=size_;
+			}
+			balanceSubtree(n);
+			return;
+		}
+		child=n;
+		childSize=size;
+	}
+}
+
+/**
+* Lets go of the compact block once the tree has no nodes in it anymore.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::dropCompactBlock()
+{
+	if (compact_!=nullptr){
+		resource_=compact_->upstream();
+		compact_->release();
+		compact_=nullptr;
+	}
+}
+
+/**
+* Frees detached nodes, at most budget steps of it. The top node's left child
+* is rotated up until the top has none, then the top is freed and its right
+* child takes its place. That needs no stack, and as every rotation moves a
+* node off the leftmost path for good there are fewer rotations than nodes.
+* The top's parent link is free for the chain of further detached roots.
+*/
+template<typename Key, typename Value>
+size_t BinarySearchTree<Key, Value>::reclaimNodes(void*& top, TreeMemoryResource* resource, size_t nodeSize, size_t nodeAlign, size_t& budget)
+{
+	Node<Key, Value>* n= static_cast<Node<Key, Value>*>(top);
+	//A resource like an arena frees all nodes together later, and if nothing needs destroying
+	//there is no reason to visit them
+	if (resource->releases_all_at_once() && std::is_trivially_destructible<Key>::value
+		&& std::is_trivially_destructible<Value>::value){
+		top=nullptr;
+		return 0;
+	}
+
+	size_t freed=0;
+	while (n!=nullptr && budget>0){
+		--budget;
+		Node<Key, Value>* left= n->getChild(false);
+		if (left!=nullptr){
+			n->setLeft(left->getChild(true));
+			left->setRight(n);
+			left->setParent(n->getParent()); //the chain moves to the new top
+			n=left;
+		}else{
+			Node<Key, Value>* right= n->getChild(true);
+			Node<Key, Value>* chain= n->getParent();
+			destroyNode(n, resource, nodeSize, nodeAlign);
+			++freed;
+			if (right!=nullptr){
+				right->setParent(chain);
+				n=right;
+			}else{
+				n=chain;
+			}
+		}
+	}
+	top=n;
+	return freed;
+}
+
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::spliceNodes(void*& top, void* other)
+{
+	Node<Key, Value>* last= static_cast<Node<Key, Value>*>(other);
+	while (last->getParent()!=nullptr){
+		last=last->getParent();
+	}
+	last->setParent(static_cast<Node<Key, Value>*>(top));
+	top=other;
+}
 
 template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::clearHelper(Node<Key, Value> *n)
@@ -698,7 +2353,7 @@ void BinarySearchTree<Key, Value>::clearHelper(Node<Key, Value> *n)
 		clearHelper(n->getRight());
 
 		//Deleting the current node
-		delete n; 
+		freeNode(n); 
 
 }		
 
@@ -730,14 +2385,32 @@ BinarySearchTree<Key, Value>::getSmallestNode() const
 */
 template<typename Key, typename Value>
 Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) const
+{
+	if (bloom_!=nullptr && !bloom_->mayContain(key)){
+		return NULL;
+	}
+	if (hashIndex_!=nullptr){
+		return hashIndex_->find(key);
+	}
+	return findNode(key, typename SearchTagFor<Key>::type());
+}
+
+/**
+* The usual search, stops as soon as it sees the key.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::findNode(const Key& key, GenericSearchTag) const
 {
 	
 	Node<Key,Value>* temp= root_; //Starting from the root 
 
 	while(temp!=NULL){ //Runs while our temporary key is not null , also checks for an empty tree
+		BST_COUNT(nodesVisited, 1);
+		BST_COUNT(comparisons, 1);
 		if ((temp->getKey())==key){
 			return temp; //Returns the pointer if key is found
 		}
+		BST_COUNT(comparisons, 1);
 		if(key<(temp->getKey())){ //If given key value is smaller than our temporary key, we need to look for the left subtree
 			temp=temp->getLeft();
 		}else{
@@ -748,6 +2421,176 @@ Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) con
 
 }
 
+/**
+* The branchless search. candidate is the last node we went left at (or whose
+* key equals key), so it ends as the smallest node with a key >= key. The
+* comparison picks the child and whether candidate moves without a jump, the
+* only branch left is the loop ending at a leaf, once per search.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::findNode(const Key& key, BranchlessSearchTag) const
+{
+	Node<Key,Value>* temp= root_;
+	Node<Key,Value>* candidate= NULL;
+	while (temp!=NULL){
+		BST_COUNT(nodesVisited, 1);
+		BST_COUNT(comparisons, 1);
+		bool right= temp->getKey()<key;
+		candidate= right ? candidate : temp;
+		temp= temp->getChild(right);
+	}
+	BST_COUNT(comparisons, 1);
+	if (candidate!=NULL && candidate->getKey()==key){
+		return candidate;
+	}
+	return NULL;
+}
+
+/**
+* Finds where key is or would be inserted. Returns the node with key, or NULL
+* with parent set to the node the new one goes under and next to its
+* successor-to-be (NULL if key would be the largest).
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::findInsertPoint(const Key& key, Node<Key, Value>*& parent, Node<Key, Value>*& next) const
+{
+	parent=NULL;
+	next=NULL;
+	return findInsertPoint(key, parent, next, typename SearchTagFor<Key>::type());
+}
+
+/**
+* The usual way: look the key up first and only if it is missing walk down again to the leaf.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::findInsertPoint(const Key& key, Node<Key, Value>*& parent, Node<Key, Value>*& next, GenericSearchTag) const
+{
+	Node<Key,Value> *found= internalFind(key); 
+	if (found!=nullptr){
+		return found;
+	}
+
+	Node<Key, Value> *temp= root_;
+	while (temp!= NULL){ 
+		parent=temp; //move down
+		BST_COUNT(nodesVisited, 1);
+		BST_COUNT(comparisons, 1);
+		if(key>temp->getKey()){ //If the new KEY is greater than the temporary one, we move right
+			temp=temp->getRight();
+		}
+		else if (key< temp->getKey()){ //If it is smaller, we move left and temp may be its successor
+			BST_COUNT(comparisons, 1);
+			next=temp;
+			temp=temp->getLeft();
+		}
+	}
+	return NULL;
+}
+
+/**
+* The branchless way needs a single walk: it goes down to a leaf like
+* findNode, and the node it would have returned is also the successor the new
+* node gets when the key is missing.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::findInsertPoint(const Key& key, Node<Key, Value>*& parent, Node<Key, Value>*& next, BranchlessSearchTag) const
+{
+	Node<Key,Value>* temp= root_;
+	while (temp!=NULL){
+		BST_COUNT(nodesVisited, 1);
+		BST_COUNT(comparisons, 1);
+		parent=temp;
+		bool right= temp->getKey()<key;
+		next= right ? next : temp;
+		temp= temp->getChild(right);
+	}
+	BST_COUNT(comparisons, 1);
+	if (next!=NULL && next->getKey()==key){
+		return next;
+	}
+	return NULL;
+}
+
+/**
+* The prefix search compares the searched key's prefix, worked out once,
+* against the one kept in each node. When they differ the prefix decides the
+* side, branchless as in the BranchlessSearch search. A tie needs the string
+* characters, and there a real branch does better: the CPU guesses the side
+* and starts on the next node while the characters are still being loaded.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::findNode(const Key& key, PrefixSearchTag) const
+{
+	const typename NodeKeyPrefix<Key>::Prefix prefix= NodeKeyPrefix<Key>::prefixOf(key);
+	Node<Key,Value>* temp= root_;
+	while (temp!=NULL){
+		BST_COUNT(nodesVisited, 1);
+		BST_COUNT(comparisons, 1);
+		const typename NodeKeyPrefix<Key>::Prefix nodePrefix= temp->keyPrefix();
+		if (prefix!=nodePrefix){
+			temp= temp->getChild(nodePrefix<prefix);
+			continue;
+		}
+		int order= NodeKeyPrefix<Key>::compareTied(key, temp->getKey());
+		if (order==0){
+			return temp;
+		}
+		if (order<0){
+			temp=temp->getLeft();
+		}else{
+			temp=temp->getRight();
+		}
+	}
+	return NULL;
+}
+
+/**
+* With a three way comparison the insert point is found in the same walk as the key.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::findInsertPoint(const Key& key, Node<Key, Value>*& parent, Node<Key, Value>*& next, PrefixSearchTag) const
+{
+	const typename NodeKeyPrefix<Key>::Prefix prefix= NodeKeyPrefix<Key>::prefixOf(key);
+	Node<Key,Value>* temp= root_;
+	while (temp!=NULL){
+		BST_COUNT(nodesVisited, 1);
+		BST_COUNT(comparisons, 1);
+		const typename NodeKeyPrefix<Key>::Prefix nodePrefix= temp->keyPrefix();
+		int order= (prefix!=nodePrefix) ? (prefix<nodePrefix ? -1 : 1) : NodeKeyPrefix<Key>::compareTied(key, temp->getKey());
+		if (order==0){
+			return temp;
+		}
+		parent=temp;
+		if (order<0){
+			next=temp;
+			temp=temp->getLeft();
+		}else{
+			temp=temp->getRight();
+		}
+	}
+	return NULL;
+}
+
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::boundNode(const Key& key, bool strict) const
+{
+	const typename NodeKeyPrefix<Key>::Prefix prefix= NodeKeyPrefix<Key>::prefixOf(key);
+	Node<Key,Value>* temp= root_;
+	Node<Key,Value>* bound= NULL; //the smallest node so far that is past key
+	while (temp!=NULL){
+		BST_COUNT(nodesVisited, 1);
+		BST_COUNT(comparisons, 1);
+		int order= temp->compare(key, prefix, temp->getKey());
+		if (order<0 || (order==0 && !strict)){
+			bound=temp;
+			temp=temp->getLeft();
+		}else{
+			temp=temp->getRight();
+		}
+	}
+	return bound;
+}
+
 /**
  * Return true if the BST is balanced.
  */
@@ -807,6 +2650,7 @@ void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value
     if((n1 == n2) || (n1 == NULL) || (n2 == NULL) ) {
         return;
     }
+    BST_COUNT(nodeSwaps, 1);
     Node<Key, Value>* n1p = n1->getParent();
     Node<Key, Value>* n1r = n1->getRight();
     Node<Key, Value>* n1lt = n1->getLeft();
@@ -885,6 +2729,103 @@ void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value
 
 }
 
+/**
+* Rotates current down to the right so that its left child takes its place.
+* Shared by the self-balancing trees that derive from BinarySearchTree.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::rightRotation(Node<Key, Value> *current)
+{
+	BST_COUNT(rotations, 1);
+	NodeLinks links(this);
+	rotateRight(links, current);
+}
+
+/**
+* Rotates current down to the left so that its right child takes its place.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::leftRotation(Node<Key, Value> *current)
+{
+	BST_COUNT(rotations, 1);
+	NodeLinks links(this);
+	rotateLeft(links, current);
+}
+
+template<typename Links>
+void rotateRight(Links& links, typename Links::NodePtr current)
+{
+	typedef typename Links::NodePtr NodePtr;
+	//This is the right subtree of the middle node, we will use this later:
+	NodePtr tempRSubtree= links.right(links.left(current));
+	NodePtr newRoot= links.left(current);
+
+	//Saving the current's parents before we modify it
+	NodePtr oldParent= links.parent(current);
+
+
+	//Now we do the rotation
+	links.setRight(newRoot, current);
+	links.setLeft(current, tempRSubtree);
+
+	if (tempRSubtree!=nullptr){ //If there is a right subtree, we update its pointers
+		links.setParent(tempRSubtree, current);
+	}
+
+	//Now we update the parent pointers
+	links.setParent(newRoot, oldParent);
+	links.setParent(current, newRoot);
+
+	//Now we update the initial root's child pointers
+	if (oldParent!=nullptr){
+		if (links.left(oldParent)==current){
+			links.setLeft(oldParent, newRoot);
+		}else{
+			links.setRight(oldParent, newRoot);
+		}
+	}else{
+		links.setRoot(newRoot);
+	}
+
+}
+
+template<typename Links>
+void rotateLeft(Links& links, typename Links::NodePtr current)
+{
+	typedef typename Links::NodePtr NodePtr;
+	//This is the left subtree of the middle node, we will use this later:
+	NodePtr tempLSubtree= links.left(links.right(current));
+	NodePtr newRoot= links.right(current);
+
+	//Saving the current's parents before we modify it
+	NodePtr oldParent= links.parent(current);
+
+
+	//Now we do the rotation
+	links.setLeft(newRoot, current);
+	links.setRight(current, tempLSubtree);
+
+	if (tempLSubtree!=nullptr){ //If there is a left subtree, we update its pointers
+		links.setParent(tempLSubtree, current);
+	}
+
+	//Now we update the parent pointers
+	links.setParent(newRoot, oldParent);
+	links.setParent(current, newRoot);
+
+	//Now we update the initial root's child pointers
+	if (oldParent!=nullptr){
+		if (links.left(oldParent)==current){
+			links.setLeft(oldParent, newRoot);
+		}else{
+			links.setRight(oldParent, newRoot);
+		}
+	}else{
+		links.setRoot(newRoot);
+	}
+
+}
+
 /**
  * Lastly, we are providing you with a print function,
    BinarySearchTree::printRoot().
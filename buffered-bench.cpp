@@ -0,0 +1,73 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include "avlbst.h"
+#include "buffered-tree.h"
+#include "bench-utils.h"
+
+using namespace std;
+
+// Ingest of random keys into an AVLTree, inserted directly and through a
+// BufferedTree with several buffer sizes. Reports ns per insert for the whole
+// ingest (the last flush included) and random lookups on the result.
+// Usage: ./buffered-bench [numKeys] [numLookups]
+
+struct RunIngest
+{
+    RunIngest(uint64_t b, uint64_t n, uint64_t l, bool f) : bufferSize(b), numKeys(n), numLookups(l), lookups(f) {}
+
+    // Returns ns per insert, or per lookup if lookups is set
+    double operator()() const
+    {
+        BenchRandom rng(1);
+        vector<uint64_t> keys(numKeys);
+        for(uint64_t i = 0; i < numKeys; ++i) {
+            keys[i] = rng.next();
+        }
+        // A buffer size of 0 stands for inserting into the tree directly
+        AVLTree<uint64_t, uint64_t> direct;
+        BufferedTree<uint64_t, uint64_t> buffered(bufferSize == 0 ? 1 : bufferSize);
+        BenchTimer timer;
+        for(uint64_t i = 0; i < numKeys; ++i) {
+            if(bufferSize == 0) {
+                direct.insert(make_pair(keys[i], i));
+            }
+            else {
+                buffered.insert(make_pair(keys[i], i));
+            }
+        }
+        AVLTree<uint64_t, uint64_t>& tree = bufferSize == 0 ? direct : buffered.tree();
+        double insertNs = timer.elapsedNs();
+        if(!lookups) {
+            return insertNs / numKeys;
+        }
+        uint64_t found = 0;
+        timer.restart();
+        for(uint64_t i = 0; i < numLookups; ++i) {
+            found += (tree.find(keys[rng.below(numKeys)]) != tree.end());
+        }
+        double ns = timer.elapsedNs();
+        benchKeep(found);
+        return ns / numLookups;
+    }
+
+    uint64_t bufferSize;
+    uint64_t numKeys;
+    uint64_t numLookups;
+    bool lookups;
+};
+
+int main(int argc, char *argv[])
+{
+    uint64_t numKeys = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+    uint64_t numLookups = argc > 2 ? strtoull(argv[2], NULL, 10) : 1000000;
+    const uint64_t bufferSizes[] = { 0, 1024, 16384, 262144, 1048576 };
+
+    cout << "keys,buffer,insert_ns,find_ns" << endl;
+    for(size_t i = 0; i < sizeof(bufferSizes) / sizeof(bufferSizes[0]); ++i) {
+        cout << numKeys << "," << (bufferSizes[i] == 0 ? string("direct") : to_string(bufferSizes[i]))
+             << "," << runIsolated(RunIngest(bufferSizes[i], numKeys, numLookups, false))
+             << "," << runIsolated(RunIngest(bufferSizes[i], numKeys, numLookups, true)) << endl;
+    }
+    return 0;
+}
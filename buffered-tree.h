@@ -0,0 +1,343 @@
+#ifndef BUFFERED_TREE_H
+#define BUFFERED_TREE_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+#include "bst-memory.h"
+
+/**
+* A write-optimized front end for a large tree (an AVLTree by default): inserts
+* and removes go into a small buffer first, which is applied to the tree in
+* one sorted batch once it holds bufferSize operations (or on flush()).
+*
+* A random insert into a big tree misses the cache on most levels of its
+* descent. The buffer is two small AVLTrees, one of buffered inserts and one
+* of keys to remove (tombstones), which stay in the cache, with their nodes in
+* an arena that is given back in one go after each flush. The flush removes the
+* tombstones' keys and then hands the inserts to Tree::insert_sorted, where
+* every search resumes from the previous one, so the upper levels of the tree
+* are walked once per batch instead of once per key. A larger buffer means
+* fewer, denser batches but more memory and a deeper buffer search.
+*
+* find() and iteration see buffer and tree merged: a buffered insert hides the
+* tree's value for its key, a tombstone hides the key. Any insert, remove or
+* flush invalidates iterators, as it would on the tree.
+*/
+template <class Key, class Value, class Tree = AVLTree<Key, Value> >
+class BufferedTree
+{
+public:
+    class iterator;
+
+    explicit BufferedTree(size_t bufferSize = 16384);
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    iterator find(const Key& key) const;
+    iterator begin() const;
+    iterator end() const;
+
+    // Applies the buffer to the tree
+    void flush();
+    // The tree with the buffer applied
+    Tree& tree();
+
+    // Operations buffered before a flush, 1 applies every one right away
+    void setBufferSize(size_t bufferSize);
+    size_t bufferSize() const;
+    // Operations buffered since the last flush
+    size_t buffered() const;
+
+    /**
+    * Walks the tree and the buffered inserts side by side in key order,
+    * skipping tree keys that the buffer overwrites or removes.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key, Value>& operator*() const;
+        std::pair<const Key, Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class BufferedTree<Key, Value, Tree>;
+        typedef typename Tree::iterator TreeIterator;
+        typedef typename AVLTree<Key, Value>::iterator InsertIterator;
+        typedef typename AVLTree<Key, bool>::iterator RemoveIterator;
+
+        iterator(const BufferedTree<Key, Value, Tree>* owner, TreeIterator tree, InsertIterator inserted,
+                 RemoveIterator removed, bool synced);
+        void settle();
+        std::pair<const Key, Value>* current() const;
+
+        const BufferedTree<Key, Value, Tree>* owner_;
+        TreeIterator tree_;          // the next tree item not yet passed
+        InsertIterator inserted_;    // the next buffered insert not yet passed
+        RemoveIterator removed_;     // the first tombstone not below tree_
+        bool inBuffer_;              // whether the current item is inserted_ or tree_
+        bool synced_;                // false while only inserted_ is known, see find()
+    };
+
+protected:
+    Tree tree_;
+    MonotonicTreeResource arena_;  // holds the nodes of the two buffer trees
+    AVLTree<Key, Value> inserted_;
+    AVLTree<Key, bool> removed_;
+    std::vector<std::pair<const Key, Value> > batch_;
+    size_t bufferSize_;
+    size_t buffered_;
+
+private:
+    // The buffer trees point into arena_
+    BufferedTree(const BufferedTree&);
+    BufferedTree& operator=(const BufferedTree&);
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the BufferedTree class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value, class Tree>
+BufferedTree<Key, Value, Tree>::BufferedTree(size_t bufferSize) :
+    arena_((bufferSize == 0 ? 1 : bufferSize) * sizeof(AVLNode<Key, Value>)), inserted_(&arena_), removed_(&arena_),
+    bufferSize_(bufferSize == 0 ? 1 : bufferSize), buffered_(0)
+{
+
+}
+
+/**
+* Buffers the insert; a later find() or iteration sees the new value.
+*/
+template<class Key, class Value, class Tree>
+void BufferedTree<Key, Value, Tree>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+	inserted_.insert(keyValuePair);
+	if (++buffered_>=bufferSize_){
+		flush();
+	}
+}
+
+/**
+* Buffers a tombstone for key, and drops a buffered insert of it.
+*/
+template<class Key, class Value, class Tree>
+void BufferedTree<Key, Value, Tree>::remove(const Key& key)
+{
+	inserted_.remove(key);
+	removed_.insert(std::make_pair(key, true));
+	if (++buffered_>=bufferSize_){
+		flush();
+	}
+}
+
+/**
+* Applies the tombstones, then the inserts (so an insert after a remove of
+* the same key wins), and empties the buffer.
+*/
+template<class Key, class Value, class Tree>
+void BufferedTree<Key, Value, Tree>::flush()
+{
+	if (buffered_==0){
+		return;
+	}
+	for (typename AVLTree<Key, bool>::iterator it= removed_.begin(); it!=removed_.end(); ++it){
+		tree_.remove(it->first);
+	}
+	batch_.clear();
+	batch_.reserve(inserted_.size());
+	for (typename AVLTree<Key, Value>::iterator it= inserted_.begin(); it!=inserted_.end(); ++it){
+		batch_.push_back(*it);
+	}
+	tree_.insert_sorted(batch_);
+	batch_.clear();
+
+	inserted_.clear();
+	removed_.clear();
+	arena_.release();
+	buffered_=0;
+}
+
+template<class Key, class Value, class Tree>
+Tree& BufferedTree<Key, Value, Tree>::tree()
+{
+	flush();
+	return tree_;
+}
+
+/**
+* Takes effect from the next operation on, a smaller size flushes then.
+*/
+template<class Key, class Value, class Tree>
+void BufferedTree<Key, Value, Tree>::setBufferSize(size_t bufferSize)
+{
+	bufferSize_= bufferSize==0 ? 1 : bufferSize;
+}
+
+template<class Key, class Value, class Tree>
+size_t BufferedTree<Key, Value, Tree>::bufferSize() const
+{
+	return bufferSize_;
+}
+
+template<class Key, class Value, class Tree>
+size_t BufferedTree<Key, Value, Tree>::buffered() const
+{
+	return buffered_;
+}
+
+/**
+* A buffered insert answers from the buffer alone; the tree is only searched
+* if the buffer knows nothing about key.
+*/
+template<class Key, class Value, class Tree>
+typename BufferedTree<Key, Value, Tree>::iterator BufferedTree<Key, Value, Tree>::find(const Key& key) const
+{
+	typename AVLTree<Key, Value>::iterator inserted= inserted_.find(key);
+	if (inserted!=inserted_.end()){
+		//Where the tree and the tombstones stand is only looked up if the iterator moves on
+		return iterator(this, tree_.end(), inserted, removed_.end(), false);
+	}
+	if (removed_.find(key)!=removed_.end()){
+		return end();
+	}
+	typename Tree::iterator found= tree_.find(key);
+	if (found==tree_.end()){
+		return end();
+	}
+	return iterator(this, found, inserted_.lower_bound(key), removed_.lower_bound(key), true);
+}
+
+template<class Key, class Value, class Tree>
+typename BufferedTree<Key, Value, Tree>::iterator BufferedTree<Key, Value, Tree>::begin() const
+{
+	return iterator(this, tree_.begin(), inserted_.begin(), removed_.begin(), true);
+}
+
+template<class Key, class Value, class Tree>
+typename BufferedTree<Key, Value, Tree>::iterator BufferedTree<Key, Value, Tree>::end() const
+{
+	return iterator(this, tree_.end(), inserted_.end(), removed_.end(), true);
+}
+
+/*
+  -----------------------------------------------------------
+  Begin implementations for the BufferedTree::iterator class.
+  -----------------------------------------------------------
+*/
+
+template<class Key, class Value, class Tree>
+BufferedTree<Key, Value, Tree>::iterator::iterator() :
+    owner_(NULL), inBuffer_(false), synced_(true)
+{
+
+}
+
+template<class Key, class Value, class Tree>
+BufferedTree<Key, Value, Tree>::iterator::iterator(const BufferedTree<Key, Value, Tree>* owner, TreeIterator tree,
+    InsertIterator inserted, RemoveIterator removed, bool synced) :
+    owner_(owner), tree_(tree), inserted_(inserted), removed_(removed), inBuffer_(true), synced_(synced)
+{
+	if (synced_){
+		settle();
+	}
+}
+
+/**
+* Skips the tree items that are removed or overwritten by the buffer and
+* picks the smaller of the two candidates. An overwritten tree item has the
+* key of inserted_ at this point, a removed one that of removed_ once the
+* tombstones below it are passed.
+*/
+template<class Key, class Value, class Tree>
+void BufferedTree<Key, Value, Tree>::iterator::settle()
+{
+	while (tree_!=owner_->tree_.end()){
+		const Key& key= tree_->first;
+		while (removed_!=owner_->removed_.end() && removed_->first<key){
+			++removed_;
+		}
+		bool hidden= (removed_!=owner_->removed_.end() && !(key<removed_->first))
+			|| (inserted_!=owner_->inserted_.end() && !(key<inserted_->first) && !(inserted_->first<key));
+		if (!hidden){
+			break;
+		}
+		++tree_;
+	}
+	if (inserted_==owner_->inserted_.end()){
+		inBuffer_=false;
+	}else if (tree_==owner_->tree_.end()){
+		inBuffer_=true;
+	}else{
+		inBuffer_= inserted_->first<tree_->first;
+	}
+}
+
+template<class Key, class Value, class Tree>
+std::pair<const Key, Value>* BufferedTree<Key, Value, Tree>::iterator::current() const
+{
+	if (owner_==NULL){
+		return NULL;
+	}
+	if (inBuffer_){
+		return inserted_==owner_->inserted_.end() ? NULL : &*inserted_;
+	}
+	return tree_==owner_->tree_.end() ? NULL : &*tree_;
+}
+
+template<class Key, class Value, class Tree>
+std::pair<const Key, Value>& BufferedTree<Key, Value, Tree>::iterator::operator*() const
+{
+	return *current();
+}
+
+template<class Key, class Value, class Tree>
+std::pair<const Key, Value>* BufferedTree<Key, Value, Tree>::iterator::operator->() const
+{
+	return current();
+}
+
+template<class Key, class Value, class Tree>
+bool BufferedTree<Key, Value, Tree>::iterator::operator==(const iterator& rhs) const
+{
+	return current()==rhs.current();
+}
+
+template<class Key, class Value, class Tree>
+bool BufferedTree<Key, Value, Tree>::iterator::operator!=(const iterator& rhs) const
+{
+	return current()!=rhs.current();
+}
+
+template<class Key, class Value, class Tree>
+typename BufferedTree<Key, Value, Tree>::iterator& BufferedTree<Key, Value, Tree>::iterator::operator++()
+{
+	if (!synced_){
+		//Came from find() on a buffered key: catch the tree up to it, its own item there is hidden
+		const Key& key= inserted_->first;
+		tree_=owner_->tree_.lower_bound(key);
+		if (tree_!=owner_->tree_.end() && !(key<tree_->first)){
+			++tree_;
+		}
+		removed_=owner_->removed_.lower_bound(key);
+		synced_=true;
+	}
+	if (inBuffer_){
+		++inserted_;
+	}else{
+		++tree_;
+	}
+	settle();
+	return *this;
+}
+
+#endif
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include "avlbst.h"
+#include "tree-reclaimer.h"
+#include "bench-utils.h"
+
+using namespace std;
+
+// How long the caller is stalled when a big tree is thrown away: clear() frees
+// every node before it returns, clear_incremental() a slice of budget steps per
+// call, and a TreeReclaimer takes the nodes in O(1) and frees them on its own
+// thread. Reports the longest single pause and, for the incremental clear, the
+// total time of all its slices.
+// Usage: ./clear-bench [maxTreeSize] [budget]
+
+enum ClearMode { Clear, Incremental, Reclaimer };
+
+struct RunClear
+{
+    RunClear(ClearMode m, uint64_t s, uint64_t b, bool t) : mode(m), treeSize(s), budget(b), total(t) {}
+
+    // Returns the longest pause in ns, or the total time if total is set
+    double operator()() const
+    {
+        TreeReclaimer reclaimer;
+        AVLTree<uint64_t, uint64_t> tree;
+        vector<uint64_t> keys = shuffledKeys(treeSize, 1);
+        for(uint64_t i = 0; i < treeSize; ++i) {
+            tree.insert(make_pair(keys[i], i));
+        }
+        uint64_t longest = 0;
+        uint64_t sum = 0;
+        BenchTimer timer;
+        if(mode == Clear) {
+            tree.clear();
+            longest = sum = timer.elapsedNs();
+        }
+        else if(mode == Incremental) {
+            bool done = false;
+            while(!done) {
+                timer.restart();
+                done = tree.clear_incremental(budget);
+                uint64_t pause = timer.elapsedNs();
+                longest = max(longest, pause);
+                sum += pause;
+            }
+        }
+        else {
+            reclaimer.clear(tree);
+            longest = sum = timer.elapsedNs();
+            reclaimer.wait_idle();
+        }
+        // The tree is usable right away in every mode
+        tree.insert(make_pair(uint64_t(1), uint64_t(1)));
+        benchKeep(tree.size());
+        return total ? sum : longest;
+    }
+
+    ClearMode mode;
+    uint64_t treeSize;
+    uint64_t budget;
+    bool total;
+};
+
+int main(int argc, char *argv[])
+{
+    uint64_t maxTreeSize = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    uint64_t budget = argc > 2 ? strtoull(argv[2], NULL, 10) : 1024;
+
+    cout << "tree_size,clear_us,incremental_max_us,incremental_total_us,reclaimer_us" << endl;
+    for(uint64_t size = 1000; size <= maxTreeSize; size *= 10) {
+        double clear = runIsolated(RunClear(Clear, size, budget, false));
+        double sliceMax = runIsolated(RunClear(Incremental, size, budget, false));
+        double sliceTotal = runIsolated(RunClear(Incremental, size, budget, true));
+        double handOff = runIsolated(RunClear(Reclaimer, size, budget, false));
+        cout << size << "," << clear / 1e3 << "," << sliceMax / 1e3 << "," << sliceTotal / 1e3 << ","
+             << handOff / 1e3 << endl;
+    }
+    return 0;
+}
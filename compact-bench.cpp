@@ -0,0 +1,69 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include "avlbst.h"
+#include "bench-utils.h"
+
+using namespace std;
+
+// Random lookups on an AVLTree aged by many removes and inserts, which leave
+// its nodes scattered over the heap, before and after compact() moves them
+// into one block in van Emde Boas order. Also reports how long compact() takes.
+// Usage: ./compact-bench [maxKeys] [numLookups]
+
+enum Measure { BEFORE, AFTER, COMPACT };
+
+struct RunLookups
+{
+    RunLookups(Measure m, uint64_t n, uint64_t l) : measure(m), numKeys(n), numLookups(l) {}
+
+    // Returns ns per lookup, or the ns compact() took
+    double operator()() const
+    {
+        AVLTree<uint64_t, uint64_t> tree;
+        BenchRandom rng(1);
+        uint64_t range = 2 * numKeys;
+        // Fill to about numKeys keys, then replace each of them about twice over
+        for(uint64_t i = 0; i < 2 * numKeys; ++i) {
+            tree.insert(make_pair(rng.below(range), i));
+        }
+        for(uint64_t i = 0; i < 2 * numKeys; ++i) {
+            tree.remove(rng.below(range));
+            tree.insert(make_pair(rng.below(range), i));
+        }
+        BenchTimer timer;
+        if(measure != BEFORE) {
+            tree.compact();
+            if(measure == COMPACT) {
+                return timer.elapsedNs();
+            }
+        }
+        uint64_t found = 0;
+        timer.restart();
+        for(uint64_t i = 0; i < numLookups; ++i) {
+            found += (tree.find(rng.below(range)) != tree.end());
+        }
+        double ns = timer.elapsedNs();
+        benchKeep(found);
+        return ns / numLookups;
+    }
+
+    Measure measure;
+    uint64_t numKeys;
+    uint64_t numLookups;
+};
+
+int main(int argc, char *argv[])
+{
+    uint64_t maxKeys = argc > 1 ? strtoull(argv[1], NULL, 10) : 4000000;
+    uint64_t numLookups = argc > 2 ? strtoull(argv[2], NULL, 10) : 2000000;
+
+    cout << "keys,before_ns,after_ns,speedup,compact_ms" << endl;
+    for(uint64_t n = 1000; n <= maxKeys; n *= 4) {
+        double before = runIsolated(RunLookups(BEFORE, n, numLookups));
+        double after = runIsolated(RunLookups(AFTER, n, numLookups));
+        double compact = runIsolated(RunLookups(COMPACT, n, numLookups));
+        cout << n << "," << before << "," << after << "," << before / after << "," << compact / 1e6 << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include "avlbst.h"
+#include "bench-utils.h"
+
+using namespace std;
+
+// Lookup throughput of AVLTree::find one key at a time against find_many
+// with several group sizes, on a tree much larger than the caches.
+// Usage: ./find-many-bench [numKeys] [numLookups]
+
+int main(int argc, char *argv[])
+{
+    uint64_t numKeys = argc > 1 ? strtoull(argv[1], NULL, 10) : 4000000;
+    uint64_t numLookups = argc > 2 ? strtoull(argv[2], NULL, 10) : 4000000;
+
+    AVLTree<uint64_t, uint64_t> tree;
+    vector<uint64_t> keys = shuffledKeys(numKeys, 1);
+    for(size_t i = 0; i < keys.size(); ++i) {
+        // Odd keys only, so half of the lookups below miss
+        tree.insert(make_pair(2 * keys[i] + 1, keys[i]));
+    }
+    vector<uint64_t> lookups(numLookups);
+    BenchRandom rng(2);
+    for(size_t i = 0; i < lookups.size(); ++i) {
+        lookups[i] = rng.below(2 * numKeys);
+    }
+
+    cout << "method,group,keys,lookups,seconds,mops_per_sec,speedup" << endl;
+    BenchTimer timer;
+    uint64_t found = 0;
+    for(size_t i = 0; i < lookups.size(); ++i) {
+        found += (tree.find(lookups[i]) != tree.end());
+    }
+    double base = timer.elapsedSec();
+    cout << "find,1," << numKeys << "," << numLookups << "," << base << ","
+         << numLookups / base / 1e6 << ",1" << endl;
+
+    // Handlers hand over batches, 1024 keys at a time here
+    const size_t batch = 1024;
+    vector<AVLTree<uint64_t, uint64_t>::iterator> results(batch);
+    size_t groups[] = { 8, 16, 32 };
+    for(int g = 0; g < 3; ++g) {
+        uint64_t foundMany = 0;
+        timer.restart();
+        for(size_t i = 0; i < lookups.size(); i += batch) {
+            size_t n = min(batch, lookups.size() - i);
+            tree.find_many(&lookups[i], n, &results[0], groups[g]);
+            for(size_t j = 0; j < n; ++j) {
+                foundMany += (results[j] != tree.end());
+            }
+        }
+        double secs = timer.elapsedSec();
+        if(foundMany != found) {
+            cerr << "find_many disagrees with find" << endl;
+            return 1;
+        }
+        cout << "find_many," << groups[g] << "," << numKeys << "," << numLookups << "," << secs << ","
+             << numLookups / secs / 1e6 << "," << base / secs << endl;
+    }
+    benchKeep(found);
+    return 0;
+}
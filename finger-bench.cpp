@@ -0,0 +1,62 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include "avlbst.h"
+#include "bench-utils.h"
+
+using namespace std;
+
+// Append throughput of AVLTree for increasing (timestamp like) keys: the
+// plain descent from the root, the automatic finger, and insert(end(), ...).
+// Random keys are included to show the finger check costs nothing there.
+// Usage: ./finger-bench [numKeys]
+
+enum Mode { DESCENT, FINGER, HINT_END };
+
+double run(Mode mode, const vector<uint64_t>& keys)
+{
+    AVLTree<uint64_t, uint64_t> tree;
+    tree.setFingerEnabled(mode != DESCENT);
+    BenchTimer timer;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        if(mode == HINT_END) tree.insert(tree.end(), make_pair(keys[i], keys[i]));
+        else tree.insert(make_pair(keys[i], keys[i]));
+    }
+    return timer.elapsedSec();
+}
+
+struct RunMode
+{
+    RunMode(Mode m, const vector<uint64_t>& k) : mode(m), keys(k) {}
+    double operator()() const { return run(mode, keys); }
+    Mode mode;
+    const vector<uint64_t>& keys;
+};
+
+int main(int argc, char *argv[])
+{
+    uint64_t numKeys = argc > 1 ? strtoull(argv[1], NULL, 10) : 5000000;
+
+    // Timestamps: increasing with small random gaps
+    vector<uint64_t> sorted(numKeys);
+    BenchRandom rng(1);
+    uint64_t t = 1600000000000ULL;
+    for(size_t i = 0; i < sorted.size(); ++i) {
+        t += 1 + rng.below(50);
+        sorted[i] = t;
+    }
+    vector<uint64_t> random = shuffledKeys(numKeys, 2);
+
+    // Each run gets its own process so they all start from a fresh heap
+    const char* names[] = { "descent", "finger", "hint-end" };
+    cout << "keys,order,mode,seconds,mops_per_sec" << endl;
+    for(int m = 0; m < 3; ++m) {
+        double secs = runIsolated(RunMode(static_cast<Mode>(m), sorted));
+        cout << numKeys << ",sorted," << names[m] << "," << secs << "," << numKeys / secs / 1e6 << endl;
+    }
+    for(int m = 0; m < 2; ++m) {
+        double secs = runIsolated(RunMode(static_cast<Mode>(m), random));
+        cout << numKeys << ",random," << names[m] << "," << secs << "," << numKeys / secs / 1e6 << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include "avlbst.h"
+#include "bench-utils.h"
+
+using namespace std;
+
+// Random point lookups on an AVLTree of random keys, with and without the
+// hash index (see setHashIndex), next to what the index costs: bytes per key
+// on top of the tree's own and the slowdown of the inserts that filled it.
+// Half the lookups are for keys that are not in the tree.
+// Usage: ./hash-index-bench [maxKeys] [numLookups]
+
+enum Measure { INSERT, FIND, BYTES_PER_KEY };
+
+struct RunIndex
+{
+    RunIndex(bool i, Measure m, uint64_t n, uint64_t l) : indexed(i), measure(m), numKeys(n), numLookups(l) {}
+
+    // Returns ns per insert or per lookup, or the tree's bytes per key
+    double operator()() const
+    {
+        BenchRandom rng(1);
+        vector<uint64_t> keys(numKeys);
+        for(uint64_t i = 0; i < numKeys; ++i) {
+            keys[i] = rng.next();
+        }
+        AVLTree<uint64_t, uint64_t> tree;
+        tree.setHashIndex(indexed);
+        BenchTimer timer;
+        for(uint64_t i = 0; i < numKeys; ++i) {
+            tree.insert(make_pair(keys[i], i));
+        }
+        double insertNs = timer.elapsedNs();
+        if(measure == INSERT) {
+            return insertNs / numKeys;
+        }
+        if(measure == BYTES_PER_KEY) {
+            return double(tree.memory_usage().total()) / numKeys;
+        }
+        uint64_t found = 0;
+        timer.restart();
+        for(uint64_t i = 0; i < numLookups; ++i) {
+            uint64_t key = (i & 1) ? keys[rng.below(numKeys)] : rng.next();
+            found += (tree.find(key) != tree.end());
+        }
+        double ns = timer.elapsedNs();
+        benchKeep(found);
+        return ns / numLookups;
+    }
+
+    bool indexed;
+    Measure measure;
+    uint64_t numKeys;
+    uint64_t numLookups;
+};
+
+int main(int argc, char *argv[])
+{
+    uint64_t maxKeys = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+    uint64_t numLookups = argc > 2 ? strtoull(argv[2], NULL, 10) : 2000000;
+
+    cout << "keys,tree_find_ns,indexed_find_ns,find_speedup,tree_insert_ns,indexed_insert_ns,"
+         << "tree_bytes_per_key,indexed_bytes_per_key" << endl;
+    for(uint64_t n = 1000; n <= maxKeys; n *= 10) {
+        double treeFind = runIsolated(RunIndex(false, FIND, n, numLookups));
+        double indexedFind = runIsolated(RunIndex(true, FIND, n, numLookups));
+        cout << n << "," << treeFind << "," << indexedFind << "," << treeFind / indexedFind
+             << "," << runIsolated(RunIndex(false, INSERT, n, numLookups))
+             << "," << runIsolated(RunIndex(true, INSERT, n, numLookups))
+             << "," << runIsolated(RunIndex(false, BYTES_PER_KEY, n, numLookups))
+             << "," << runIsolated(RunIndex(true, BYTES_PER_KEY, n, numLookups)) << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include "avlbst.h"
+#include "bench-utils.h"
+
+using namespace std;
+
+// Random lookups and a full in-order scan on an AVLTree with values of
+// several sizes, once with the value inline in the node and once out of line
+// (see StoreValueOutOfLine in bst.h). The default picks out of line above
+// kMaxInlineValueBytes.
+// Usage: ./hot-cold-bench [numKeys] [numLookups]
+
+template<size_t N>
+struct InlineValue
+{
+    char bytes[N];
+};
+
+template<size_t N>
+struct OutOfLineValue
+{
+    char bytes[N];
+};
+
+template<size_t N>
+struct StoreValueOutOfLine<uint64_t, InlineValue<N> > : std::false_type {};
+
+template<size_t N>
+struct StoreValueOutOfLine<uint64_t, OutOfLineValue<N> > : std::true_type {};
+
+template<size_t N>
+ostream& operator<<(ostream& out, const InlineValue<N>&)
+{
+    return out;
+}
+
+template<size_t N>
+ostream& operator<<(ostream& out, const OutOfLineValue<N>&)
+{
+    return out;
+}
+
+enum Mode { CONTAINS, FIND, SCAN };
+
+template<class Value>
+struct Run
+{
+    Run(Mode m, uint64_t n, uint64_t l) : mode(m), numKeys(n), numLookups(l) {}
+
+    // Returns ns per lookup, or per item for a scan. CONTAINS only tests for
+    // the key (half of them miss), FIND also reads the value
+    double operator()() const
+    {
+        AVLTree<uint64_t, Value> tree;
+        vector<uint64_t> keys = shuffledKeys(numKeys, 1);
+        Value value = Value();
+        for(size_t i = 0; i < keys.size(); ++i) {
+            value.bytes[0] = static_cast<char>(keys[i]);
+            tree.insert(make_pair(keys[i], value));
+        }
+        uint64_t sum = 0;
+        BenchTimer timer;
+        if(mode == CONTAINS) {
+            BenchRandom rng(2);
+            for(size_t i = 0; i < numLookups; ++i) {
+                sum += (tree.find(rng.below(2 * numKeys)) != tree.end());
+            }
+        }
+        else if(mode == FIND) {
+            BenchRandom rng(2);
+            for(size_t i = 0; i < numLookups; ++i) {
+                sum += tree.find(rng.below(numKeys))->second.bytes[0];
+            }
+        }
+        else {
+            for(typename AVLTree<uint64_t, Value>::iterator it = tree.begin(); it != tree.end(); ++it) {
+                sum += it->second.bytes[0];
+            }
+        }
+        double secs = timer.elapsedSec();
+        benchKeep(sum);
+        return secs * 1e9 / (mode == SCAN ? numKeys : numLookups);
+    }
+
+    Mode mode;
+    uint64_t numKeys;
+    uint64_t numLookups;
+};
+
+template<size_t N>
+void compare(uint64_t numKeys, uint64_t numLookups)
+{
+    const char* names[] = { "contains", "find", "scan" };
+    for(int m = 0; m < 3; ++m) {
+        double inlined = runIsolated(Run<InlineValue<N> >(static_cast<Mode>(m), numKeys, numLookups));
+        double split = runIsolated(Run<OutOfLineValue<N> >(static_cast<Mode>(m), numKeys, numLookups));
+        cout << N << "," << names[m] << "," << numKeys << "," << inlined << "," << split << ","
+             << inlined / split << "," << (N > kMaxInlineValueBytes ? "out_of_line" : "inline") << endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t numKeys = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    uint64_t numLookups = argc > 2 ? strtoull(argv[2], NULL, 10) : 2000000;
+
+    cout << "value_bytes,op,keys,inline_ns,out_of_line_ns,speedup,default" << endl;
+    compare<16>(numKeys, numLookups);
+    compare<32>(numKeys, numLookups);
+    compare<64>(numKeys, numLookups);
+    compare<128>(numKeys, numLookups);
+    compare<200>(numKeys, numLookups);
+    compare<512>(numKeys, numLookups);
+    return 0;
+}
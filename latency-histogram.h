@@ -0,0 +1,142 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <sstream>
+
+/**
+* A log-linear (HDR style) histogram of latencies in nanoseconds.
+*
+* Values below 32 get a bucket each. Above that every power of two range is
+* split into 32 equal sub-buckets, so a recorded value is off by at most
+* 1/32 (about 3%) of itself while the whole 64 bit range fits in a fixed
+* array. Recording is an index computation and one increment.
+*
+* The counters are relaxed atomics so another thread may read (merge) a
+* histogram while its owner keeps recording. Only one thread should record
+* into a given histogram, which is why the increment is a plain load/store
+* instead of a locked read-modify-write.
+*/
+class LatencyHistogram
+{
+public:
+    static const int kSubBucketBits = 5;
+    static const uint64_t kSubBuckets = 1ULL << kSubBucketBits;
+    static const int kBuckets = static_cast<int>(kSubBuckets + (64 - kSubBucketBits) * kSubBuckets);
+
+    LatencyHistogram() { reset(); }
+    LatencyHistogram(const LatencyHistogram& other) { reset(); add(other); }
+    LatencyHistogram& operator=(const LatencyHistogram& other)
+    {
+        if(this != &other) {
+            reset();
+            add(other);
+        }
+        return *this;
+    }
+
+    // Records one value. Single writer only, see above.
+    void record(uint64_t ns)
+    {
+        bump(counts_[bucketOf(ns)], 1);
+        bump(count_, 1);
+        bump(sum_, ns);
+        if(ns > max_.load(std::memory_order_relaxed)) max_.store(ns, std::memory_order_relaxed);
+    }
+
+    // Adds the counts of other into this histogram
+    void add(const LatencyHistogram& other)
+    {
+        for(int i = 0; i < kBuckets; ++i) {
+            uint64_t c = other.counts_[i].load(std::memory_order_relaxed);
+            if(c != 0) counts_[i].fetch_add(c, std::memory_order_relaxed);
+        }
+        count_.fetch_add(other.count_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        sum_.fetch_add(other.sum_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        uint64_t otherMax = other.max_.load(std::memory_order_relaxed);
+        if(otherMax > max_.load(std::memory_order_relaxed)) max_.store(otherMax, std::memory_order_relaxed);
+    }
+
+    void reset()
+    {
+        for(int i = 0; i < kBuckets; ++i) counts_[i].store(0, std::memory_order_relaxed);
+        count_.store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+    double mean() const
+    {
+        uint64_t c = count();
+        return c == 0 ? 0.0 : double(sum_.load(std::memory_order_relaxed)) / c;
+    }
+
+    /**
+    * Returns the value at percentile p (0..100), reported as the upper edge of
+    * its bucket so it never under-states a tail. Returns 0 when empty.
+    */
+    uint64_t percentile(double p) const
+    {
+        uint64_t total = count();
+        if(total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(p / 100.0 * total + 0.5);
+        if(rank < 1) rank = 1;
+        if(rank > total) rank = total;
+        uint64_t seen = 0;
+        for(int i = 0; i < kBuckets; ++i) {
+            seen += counts_[i].load(std::memory_order_relaxed);
+            if(seen >= rank) {
+                uint64_t upper = bucketUpper(i);
+                return upper < max() ? upper : max();
+            }
+        }
+        return max();
+    }
+
+    /**
+    * One line text summary, e.g. "find count=10 mean=52.1 p50=48 ... max=91 (ns)".
+    */
+    std::string summary(const std::string& name) const
+    {
+        std::ostringstream out;
+        out << name << " count=" << count() << " mean=" << mean()
+            << " p50=" << percentile(50) << " p99=" << percentile(99)
+            << " p999=" << percentile(99.9) << " max=" << max() << " (ns)";
+        return out.str();
+    }
+
+    static int bucketOf(uint64_t ns)
+    {
+        if(ns < kSubBuckets) return static_cast<int>(ns);
+        int msb = 63 - __builtin_clzll(ns);
+        int shift = msb - kSubBucketBits;
+        // ns >> shift lies in [kSubBuckets, 2 * kSubBuckets)
+        return static_cast<int>(kSubBuckets * (shift + 1) + ((ns >> shift) - kSubBuckets));
+    }
+
+    // Largest value that lands in bucket i
+    static uint64_t bucketUpper(int i)
+    {
+        if(i < static_cast<int>(kSubBuckets)) return i;
+        int shift = i / static_cast<int>(kSubBuckets) - 1;
+        uint64_t sub = i % kSubBuckets;
+        return ((kSubBuckets + sub + 1) << shift) - 1;
+    }
+
+private:
+    static void bump(std::atomic<uint64_t>& counter, uint64_t n)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> counts_[kBuckets];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+};
+
+#endif
@@ -0,0 +1,388 @@
+#ifndef LOGGED_TREE_H
+#define LOGGED_TREE_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "avlbst.h"
+#include "bst-snapshot.h"
+
+/**
+* A durability wrapper around an in-memory tree (an AVLTree by default) made
+* of two files next to each other:
+*
+*   <path>.ckpt  a snapshot of the whole tree (see save()/load())
+*   <path>.log   every insert/remove since that snapshot
+*
+* Each insert/remove is applied to the tree and a small record is added to a
+* buffer. commit() writes the buffered records as one frame (length, record
+* count, checksum, records) and waits for fdatasync, so many operations share
+* one disk flush (group commit). By default this happens automatically every
+* groupCommitOps operations; an operation is only durable once the commit
+* after it returns.
+*
+* checkpoint() writes the whole tree to a new snapshot and empties the log.
+* It also runs automatically when the log grows past checkpointBytes.
+*
+* Opening recovers: the snapshot is loaded and the log replayed on top of it.
+* A frame cut short by a crash fails its checksum, replay stops there and the
+* log is truncated back to the last whole frame. Inserts overwrite and removes
+* delete, so replaying a log over a snapshot that already contains it (a crash
+* between writing the snapshot and emptying the log) gives the same tree.
+*
+* Records and snapshots share the BSTSerializer format, in machine byte order.
+*/
+template <class Key, class Value, class Tree = AVLTree<Key, Value> >
+class LoggedTree
+{
+public:
+    typedef typename Tree::iterator iterator;
+
+    explicit LoggedTree(const std::string& path, unsigned groupCommitOps = 64,
+                        uint64_t checkpointBytes = 64 << 20);
+    ~LoggedTree();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    iterator find(const Key& key) const;
+    iterator begin() const;
+    iterator end() const;
+
+    // The recovered tree; changes made directly to it are not logged
+    const Tree& tree() const;
+
+    // Makes every operation so far durable
+    void commit();
+    // Writes the whole tree and empties the log
+    void checkpoint();
+
+    // 1 commits after every operation, 0 only on commit()/checkpoint()
+    void setGroupCommit(unsigned groupCommitOps);
+    // 0 turns the automatic checkpoints off
+    void setCheckpointBytes(uint64_t checkpointBytes);
+    uint64_t logBytes() const;
+
+protected:
+    enum Record { kInsertRecord = 1, kRemoveRecord = 2 };
+    static const uint32_t kFrameMagic = 0x4c474654;  // "TFGL"
+
+    void recover();
+    void replay(const std::string& payload, uint32_t records);
+    void afterRecord();
+    static uint32_t checksum(const char* data, size_t size);
+    void fail(const std::string& what) const;
+
+    Tree tree_;
+    std::string logPath_;
+    std::string checkpointPath_;
+    int logFd_;
+    uint64_t logBytes_;          // bytes in the log file, all of them whole frames
+    std::ostringstream pending_; // records since the last commit
+    SnapshotWriter writer_;
+    unsigned pendingOps_;
+    unsigned groupCommitOps_;
+    uint64_t checkpointBytes_;
+
+private:
+    // The files belong to this object
+    LoggedTree(const LoggedTree&);
+    LoggedTree& operator=(const LoggedTree&);
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the LoggedTree class.
+  -------------------------------------------------
+*/
+
+/**
+* Opens (creating if needed) the log files at path and recovers the tree.
+* Throws std::runtime_error if the files cannot be read or written.
+*/
+template<class Key, class Value, class Tree>
+LoggedTree<Key, Value, Tree>::LoggedTree(const std::string& path, unsigned groupCommitOps, uint64_t checkpointBytes) :
+    logPath_(path + ".log"), checkpointPath_(path + ".ckpt"), logFd_(-1), logBytes_(0),
+    writer_(pending_), pendingOps_(0), groupCommitOps_(groupCommitOps), checkpointBytes_(checkpointBytes)
+{
+	recover();
+}
+
+/**
+* Commits what is still buffered. Errors can not be reported from here, call
+* commit() first to find out about them.
+*/
+template<class Key, class Value, class Tree>
+LoggedTree<Key, Value, Tree>::~LoggedTree()
+{
+	try{
+		commit();
+	}catch (...){
+	}
+	close(logFd_);
+}
+
+template<class Key, class Value, class Tree>
+void LoggedTree<Key, Value, Tree>::fail(const std::string& what) const
+{
+	throw std::runtime_error(what + ": " + strerror(errno));
+}
+
+/**
+* FNV-1a, enough to tell a torn or garbled frame from a whole one.
+*/
+template<class Key, class Value, class Tree>
+uint32_t LoggedTree<Key, Value, Tree>::checksum(const char* data, size_t size)
+{
+	uint32_t hash=2166136261u;
+	for (size_t i=0; i<size; ++i){
+		hash^=static_cast<unsigned char>(data[i]);
+		hash*=16777619u;
+	}
+	return hash;
+}
+
+/**
+* Loads the snapshot, replays every whole frame of the log and cuts off the rest.
+*/
+template<class Key, class Value, class Tree>
+void LoggedTree<Key, Value, Tree>::recover()
+{
+	{
+		std::ifstream snapshot(checkpointPath_.c_str(), std::ios::binary);
+		if (snapshot){
+			tree_.load(snapshot);
+		}
+	}
+
+	logFd_= open(logPath_.c_str(), O_RDWR | O_CREAT, 0644);
+	if (logFd_<0){
+		fail("cannot open " + logPath_);
+	}
+	std::ifstream log(logPath_.c_str(), std::ios::binary);
+	std::string payload;
+	while (true){
+		uint32_t frame[4]; //magic, payload length, number of records, checksum
+		if (!log.read(reinterpret_cast<char*>(frame), sizeof(frame)) || frame[0]!=kFrameMagic){
+			break;
+		}
+		payload.resize(frame[1]);
+		if (frame[1]>0 && !log.read(&payload[0], frame[1])){
+			break;
+		}
+		if (checksum(payload.data(), payload.size())!=frame[3]){
+			break;
+		}
+		replay(payload, frame[2]);
+		logBytes_+=sizeof(frame)+frame[1];
+	}
+
+	//Whatever follows the last whole frame never finished committing
+	if (ftruncate(logFd_, logBytes_)!=0 || lseek(logFd_, logBytes_, SEEK_SET)<0){
+		fail("cannot truncate " + logPath_);
+	}
+}
+
+/**
+* Applies the records of one frame to the tree.
+*/
+template<class Key, class Value, class Tree>
+void LoggedTree<Key, Value, Tree>::replay(const std::string& payload, uint32_t records)
+{
+	std::istringstream in(payload);
+	SnapshotReader reader(in);
+	for (uint32_t i=0; i<records; ++i){
+		uint8_t type;
+		Key key;
+		reader.readRaw(type);
+		BSTSerializer<Key>::read(reader, key);
+		if (type==kInsertRecord){
+			Value value;
+			BSTSerializer<Value>::read(reader, value);
+			tree_.insert(std::make_pair(key, value));
+		}else if (type==kRemoveRecord){
+			tree_.remove(key);
+		}else{
+			//The checksum matched, so this is not a torn frame but a log we can not read
+			throw std::runtime_error("unknown record type in " + logPath_);
+		}
+	}
+}
+
+template<class Key, class Value, class Tree>
+void LoggedTree<Key, Value, Tree>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+	tree_.insert(keyValuePair);
+	writer_.writeRaw(static_cast<uint8_t>(kInsertRecord));
+	BSTSerializer<Key>::write(writer_, keyValuePair.first);
+	BSTSerializer<Value>::write(writer_, keyValuePair.second);
+	afterRecord();
+}
+
+template<class Key, class Value, class Tree>
+void LoggedTree<Key, Value, Tree>::remove(const Key& key)
+{
+	tree_.remove(key);
+	writer_.writeRaw(static_cast<uint8_t>(kRemoveRecord));
+	BSTSerializer<Key>::write(writer_, key);
+	afterRecord();
+}
+
+template<class Key, class Value, class Tree>
+void LoggedTree<Key, Value, Tree>::afterRecord()
+{
+	if (++pendingOps_>=groupCommitOps_ && groupCommitOps_!=0){
+		commit();
+	}
+}
+
+/**
+* Writes the buffered records as one frame and waits until it is on disk.
+* Checkpoints instead once the log has outgrown checkpointBytes. If writing
+* or syncing fails, the log is cut back to its last whole frame and the
+* records stay buffered, so a later commit() writes them again.
+*/
+template<class Key, class Value, class Tree>
+void LoggedTree<Key, Value, Tree>::commit()
+{
+	if (pendingOps_==0){
+		return;
+	}
+	writer_.flush();
+	std::string payload= pending_.str();
+	uint32_t frame[4]={ kFrameMagic, static_cast<uint32_t>(payload.size()), pendingOps_, checksum(payload.data(), payload.size()) };
+	std::string bytes(reinterpret_cast<const char*>(frame), sizeof(frame));
+	bytes+=payload;
+
+	size_t written=0;
+	const char* failed=NULL;
+	while (written<bytes.size() && failed==NULL){
+		ssize_t n= write(logFd_, bytes.data()+written, bytes.size()-written);
+		if (n<0){
+			if (errno!=EINTR){
+				failed="cannot write ";
+			}
+			continue;
+		}
+		written+=n;
+	}
+	if (failed==NULL && fdatasync(logFd_)!=0){
+		failed="cannot sync ";
+	}
+	if (failed!=NULL){
+		//A torn frame would end recovery early and hide every later frame behind it
+		int error=errno;
+		if (ftruncate(logFd_, logBytes_)!=0 || lseek(logFd_, logBytes_, SEEK_SET)<0){
+			fail("cannot truncate " + logPath_);
+		}
+		errno=error;
+		fail(failed + logPath_);
+	}
+	logBytes_+=bytes.size();
+	pending_.str(std::string());
+	pendingOps_=0;
+
+	if (checkpointBytes_!=0 && logBytes_>=checkpointBytes_){
+		checkpoint();
+	}
+}
+
+/**
+* Writes the tree to a temporary snapshot, syncs it and renames it over the
+* old one, then empties the log. A crash at any point leaves either the old
+* snapshot with the full log or the new snapshot, both recover the same tree.
+*/
+template<class Key, class Value, class Tree>
+void LoggedTree<Key, Value, Tree>::checkpoint()
+{
+	commit();
+
+	std::string tempPath= checkpointPath_ + ".tmp";
+	{
+		std::ofstream out(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+		tree_.save(out);
+		out.close();
+		if (!out){
+			throw std::runtime_error("cannot write " + tempPath);
+		}
+	}
+	int fd= open(tempPath.c_str(), O_RDONLY);
+	if (fd<0 || fsync(fd)!=0){
+		if (fd>=0){
+			close(fd);
+		}
+		fail("cannot sync " + tempPath);
+	}
+	close(fd);
+	if (rename(tempPath.c_str(), checkpointPath_.c_str())!=0){
+		fail("cannot rename " + tempPath);
+	}
+
+	//The rename itself has to reach the disk before the log may go
+	std::string dir= ".";
+	size_t slash= checkpointPath_.rfind('/');
+	if (slash!=std::string::npos){
+		dir= checkpointPath_.substr(0, slash+1);
+	}
+	fd= open(dir.c_str(), O_RDONLY);
+	if (fd>=0){
+		fsync(fd);
+		close(fd);
+	}
+
+	if (ftruncate(logFd_, 0)!=0 || lseek(logFd_, 0, SEEK_SET)<0 || fdatasync(logFd_)!=0){
+		fail("cannot truncate " + logPath_);
+	}
+	logBytes_=0;
+}
+
+template<class Key, class Value, class Tree>
+typename LoggedTree<Key, Value, Tree>::iterator LoggedTree<Key, Value, Tree>::find(const Key& key) const
+{
+	return tree_.find(key);
+}
+
+template<class Key, class Value, class Tree>
+typename LoggedTree<Key, Value, Tree>::iterator LoggedTree<Key, Value, Tree>::begin() const
+{
+	return tree_.begin();
+}
+
+template<class Key, class Value, class Tree>
+typename LoggedTree<Key, Value, Tree>::iterator LoggedTree<Key, Value, Tree>::end() const
+{
+	return tree_.end();
+}
+
+template<class Key, class Value, class Tree>
+const Tree& LoggedTree<Key, Value, Tree>::tree() const
+{
+	return tree_;
+}
+
+template<class Key, class Value, class Tree>
+void LoggedTree<Key, Value, Tree>::setGroupCommit(unsigned groupCommitOps)
+{
+	groupCommitOps_=groupCommitOps;
+}
+
+template<class Key, class Value, class Tree>
+void LoggedTree<Key, Value, Tree>::setCheckpointBytes(uint64_t checkpointBytes)
+{
+	checkpointBytes_=checkpointBytes;
+}
+
+template<class Key, class Value, class Tree>
+uint64_t LoggedTree<Key, Value, Tree>::logBytes() const
+{
+	return logBytes_;
+}
+
+#endif
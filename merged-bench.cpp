@@ -0,0 +1,91 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include "avlbst.h"
+#include "merged-view.h"
+#include "bench-utils.h"
+
+using namespace std;
+
+// The same random keys spread over 1 to maxShards AVLTrees, scanned in order
+// through a MergedView, next to one AVLTree holding all of them. Reports ns
+// per item for a full scan and ns per lower_bound() seek followed by a short
+// scan of 10 items.
+// Usage: ./merged-bench [numKeys] [maxShards] [numSeeks]
+
+struct RunScan
+{
+    RunScan(uint64_t n, uint64_t s, uint64_t k, bool m, bool f) :
+        numKeys(n), numShards(s), numSeeks(k), merged(m), seeks(f) {}
+
+    // Returns ns per item scanned, or per seek if seeks is set
+    double operator()() const
+    {
+        BenchRandom rng(1);
+        vector<AVLTree<uint64_t, uint64_t> > shards(merged ? numShards : 1);
+        MergedView<uint64_t, uint64_t> view;
+        for(size_t i = 0; i < shards.size(); ++i) {
+            view.add(shards[i]);
+        }
+        for(uint64_t i = 0; i < numKeys; ++i) {
+            shards[rng.below(shards.size())].insert(make_pair(rng.next(), i));
+        }
+        uint64_t sum = 0;
+        BenchTimer timer;
+        if(!seeks) {
+            if(merged) {
+                for(MergedView<uint64_t, uint64_t>::iterator it = view.begin(); it != view.end(); ++it) {
+                    sum += it->second;
+                }
+            }
+            else {
+                for(AVLTree<uint64_t, uint64_t>::iterator it = shards[0].begin(); it != shards[0].end(); ++it) {
+                    sum += it->second;
+                }
+            }
+            double ns = timer.elapsedNs();
+            benchKeep(sum);
+            return ns / numKeys;
+        }
+        for(uint64_t i = 0; i < numSeeks; ++i) {
+            uint64_t key = rng.next();
+            if(merged) {
+                MergedView<uint64_t, uint64_t>::iterator it = view.lower_bound(key);
+                for(int j = 0; j < 10 && it != view.end(); ++j, ++it) {
+                    sum += it->second;
+                }
+            }
+            else {
+                AVLTree<uint64_t, uint64_t>::iterator it = shards[0].lower_bound(key);
+                for(int j = 0; j < 10 && it != shards[0].end(); ++j, ++it) {
+                    sum += it->second;
+                }
+            }
+        }
+        double ns = timer.elapsedNs();
+        benchKeep(sum);
+        return ns / numSeeks;
+    }
+
+    uint64_t numKeys;
+    uint64_t numShards;
+    uint64_t numSeeks;
+    bool merged;
+    bool seeks;
+};
+
+int main(int argc, char *argv[])
+{
+    uint64_t numKeys = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    uint64_t maxShards = argc > 2 ? strtoull(argv[2], NULL, 10) : 64;
+    uint64_t numSeeks = argc > 3 ? strtoull(argv[3], NULL, 10) : 200000;
+
+    cout << "keys,shards,scan_ns_per_item,seek10_ns" << endl;
+    cout << numKeys << ",one tree," << runIsolated(RunScan(numKeys, 1, numSeeks, false, false))
+         << "," << runIsolated(RunScan(numKeys, 1, numSeeks, false, true)) << endl;
+    for(uint64_t s = 1; s <= maxShards; s *= 4) {
+        cout << numKeys << "," << s << "," << runIsolated(RunScan(numKeys, s, numSeeks, true, false))
+             << "," << runIsolated(RunScan(numKeys, s, numSeeks, true, true)) << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,266 @@
+#ifndef MERGED_VIEW_H
+#define MERGED_VIEW_H
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "bst.h"
+
+/**
+* A read-only view of several trees (shards, time windows, ...) as one sorted
+* sequence. Its iterator walks each tree with the tree's own iterator and keeps
+* the trees' current items in a small heap, so stepping costs O(log N) key
+* compares for N trees and nothing is copied: operator* hands out the item in
+* its tree.
+*
+* When trees share a key, the duplicates come out in the order the trees were
+* added (ALL), or only the one from the first (FIRST_WINS) or last
+* (LAST_WINS) of those trees does, say to let a newer shard override an older
+* one. Changing a tree invalidates the view's iterators, as it would the
+* tree's.
+*/
+template <class Key, class Value>
+class MergedView
+{
+public:
+    enum Duplicates { ALL, FIRST_WINS, LAST_WINS };
+
+    class iterator;
+
+    explicit MergedView(Duplicates duplicates = ALL);
+
+    // The tree must outlive the view; returns its index, see iterator::source()
+    size_t add(const BinarySearchTree<Key, Value>& tree);
+    size_t trees() const;
+    void setDuplicates(Duplicates duplicates);
+
+    iterator begin() const;
+    iterator end() const;
+    // Seeks every tree to its first key not less than key
+    iterator lower_bound(const Key& key) const;
+    iterator find(const Key& key) const;
+
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key, Value>& operator*() const;
+        std::pair<const Key, Value>* operator->() const;
+        // Index of the tree the current item is in
+        size_t source() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class MergedView<Key, Value>;
+        typedef typename BinarySearchTree<Key, Value>::iterator TreeIterator;
+
+        struct Cursor
+        {
+            TreeIterator it;
+            TreeIterator end;
+            size_t source;
+        };
+
+        // Heap order: true if a comes out after b
+        struct Later
+        {
+            bool lastWins;
+            bool operator()(const Cursor& a, const Cursor& b) const
+            {
+                if(b.it->first < a.it->first) return true;
+                if(a.it->first < b.it->first) return false;
+                return lastWins ? a.source < b.source : a.source > b.source;
+            }
+        };
+
+        iterator(const MergedView<Key, Value>* view, bool seek, const Key* key);
+        void push(const Cursor& cursor);
+        void advanceTop();
+
+        Duplicates duplicates_;
+        std::vector<Cursor> heap_;   // the trees not yet used up, heap_.front() is the current item
+    };
+
+protected:
+    std::vector<const BinarySearchTree<Key, Value>*> trees_;
+    Duplicates duplicates_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the MergedView class.
+  -----------------------------------------------
+*/
+
+template<class Key, class Value>
+MergedView<Key, Value>::MergedView(Duplicates duplicates) : duplicates_(duplicates)
+{
+
+}
+
+template<class Key, class Value>
+size_t MergedView<Key, Value>::add(const BinarySearchTree<Key, Value>& tree)
+{
+	trees_.push_back(&tree);
+	return trees_.size()-1;
+}
+
+template<class Key, class Value>
+size_t MergedView<Key, Value>::trees() const
+{
+	return trees_.size();
+}
+
+/**
+* Applies to iterators made after the call.
+*/
+template<class Key, class Value>
+void MergedView<Key, Value>::setDuplicates(Duplicates duplicates)
+{
+	duplicates_=duplicates;
+}
+
+template<class Key, class Value>
+typename MergedView<Key, Value>::iterator MergedView<Key, Value>::begin() const
+{
+	return iterator(this, false, NULL);
+}
+
+template<class Key, class Value>
+typename MergedView<Key, Value>::iterator MergedView<Key, Value>::end() const
+{
+	return iterator();
+}
+
+template<class Key, class Value>
+typename MergedView<Key, Value>::iterator MergedView<Key, Value>::lower_bound(const Key& key) const
+{
+	return iterator(this, true, &key);
+}
+
+/**
+* The item for key that iteration would yield first, with the rest of the
+* view after it.
+*/
+template<class Key, class Value>
+typename MergedView<Key, Value>::iterator MergedView<Key, Value>::find(const Key& key) const
+{
+	iterator it= lower_bound(key);
+	if (it!=end() && key<it->first){
+		return end();
+	}
+	return it;
+}
+
+/*
+  ---------------------------------------------------------
+  Begin implementations for the MergedView::iterator class.
+  ---------------------------------------------------------
+*/
+
+template<class Key, class Value>
+MergedView<Key, Value>::iterator::iterator() : duplicates_(ALL)
+{
+
+}
+
+template<class Key, class Value>
+MergedView<Key, Value>::iterator::iterator(const MergedView<Key, Value>* view, bool seek, const Key* key) :
+    duplicates_(view->duplicates_)
+{
+	heap_.reserve(view->trees_.size());
+	for (size_t i=0; i<view->trees_.size(); i++){
+		const BinarySearchTree<Key, Value>* tree= view->trees_[i];
+		Cursor cursor;
+		cursor.it= seek ? tree->lower_bound(*key) : tree->begin();
+		cursor.end= tree->end();
+		cursor.source=i;
+		push(cursor);
+	}
+}
+
+template<class Key, class Value>
+void MergedView<Key, Value>::iterator::push(const Cursor& cursor)
+{
+	if (cursor.it==cursor.end){
+		return;
+	}
+	heap_.push_back(cursor);
+	Later later;
+	later.lastWins= duplicates_==LAST_WINS;
+	std::push_heap(heap_.begin(), heap_.end(), later);
+}
+
+/**
+* Moves the tree of the current item on to its next item.
+*/
+template<class Key, class Value>
+void MergedView<Key, Value>::iterator::advanceTop()
+{
+	Later later;
+	later.lastWins= duplicates_==LAST_WINS;
+	std::pop_heap(heap_.begin(), heap_.end(), later);
+	Cursor cursor= heap_.back();
+	heap_.pop_back();
+	++cursor.it;
+	push(cursor);
+}
+
+template<class Key, class Value>
+std::pair<const Key, Value>& MergedView<Key, Value>::iterator::operator*() const
+{
+	return *heap_.front().it;
+}
+
+template<class Key, class Value>
+std::pair<const Key, Value>* MergedView<Key, Value>::iterator::operator->() const
+{
+	return &*heap_.front().it;
+}
+
+template<class Key, class Value>
+size_t MergedView<Key, Value>::iterator::source() const
+{
+	return heap_.front().source;
+}
+
+/**
+* Two iterators are equal if they are on the same item, or both at the end.
+*/
+template<class Key, class Value>
+bool MergedView<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+	if (heap_.empty() || rhs.heap_.empty()){
+		return heap_.empty() && rhs.heap_.empty();
+	}
+	return heap_.front().it==rhs.heap_.front().it;
+}
+
+template<class Key, class Value>
+bool MergedView<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+	return !(*this==rhs);
+}
+
+template<class Key, class Value>
+typename MergedView<Key, Value>::iterator& MergedView<Key, Value>::iterator::operator++()
+{
+	//The node stays where it is when its tree moves past it, so the key can be used without a copy
+	const Key& key= heap_.front().it->first;
+	advanceTop();
+	if (duplicates_!=ALL){
+		//The item just passed was the winner for its key, skip the other trees' items for it
+		while (!heap_.empty() && !(key<heap_.front().it->first)){
+			advanceTop();
+		}
+	}
+	return *this;
+}
+
+#endif
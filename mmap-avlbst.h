@@ -0,0 +1,594 @@
+#ifndef MMAP_AVLBST_H
+#define MMAP_AVLBST_H
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <utility>
+#include <type_traits>
+#include <algorithm>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "avlbst.h"
+
+/**
+* An AVL tree whose nodes live in a memory mapped file, so the tree survives
+* a restart (or is opened read-only by other processes) without any load
+* step: opening the file is all it takes.
+*
+* Nodes link to each other through byte offsets into the file rather than
+* pointers, since the file maps to a different address in every process and
+* after every growth. Offset 0 is the file header, so it doubles as NULL.
+* Insert and remove rebalance with AVLTree's code (AVLAlgorithms and the
+* rotations of bst.h), which reach the offset links through Links. The file
+* grows by doubling when it runs out of room, and removed nodes go on a free
+* list inside the file to be reused.
+*
+* Keys and values are stored as raw bytes, so both have to be trivially
+* copyable. Changes reach the file whenever the kernel writes the pages back;
+* sync() makes them durable at a point of your choosing. The file is only
+* consistent between operations: a crash in the middle of an insert or remove
+* can leave it broken, so pair it with sync() and a backup (or snapshot) when
+* that matters. Readers see the file as it was mapped when they opened it and
+* should not share it with a process that is still writing.
+*/
+template <class Key, class Value>
+class PersistentAVLTree
+{
+    static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+                  "PersistentAVLTree stores raw bytes, keys and values must be trivially copyable");
+public:
+    enum OpenMode { ReadWrite, ReadOnly };
+
+    // Opens (or in ReadWrite mode creates) the tree stored at path
+    explicit PersistentAVLTree(const std::string& path, OpenMode mode = ReadWrite);
+    ~PersistentAVLTree();
+
+    void insert(const std::pair<const Key, Value>& new_item);
+    void remove(const Key& key);
+    void clear();
+    bool empty() const;
+    uint64_t size() const;
+
+    // Blocks until every change so far is written to the file
+    void sync();
+
+    /**
+    * Iterates in key order. It holds an offset, not a pointer, so it stays
+    * valid when the file grows (as long as its node is not removed), but a
+    * reference obtained from it does not.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class PersistentAVLTree<Key, Value>;
+        iterator(const PersistentAVLTree<Key, Value>* tree, uint64_t offset);
+        const PersistentAVLTree<Key, Value>* tree_;
+        uint64_t offset_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+
+protected:
+    // A node as it is laid out in the file
+    struct PNode
+    {
+        uint64_t parent;
+        uint64_t left;
+        uint64_t right;
+        int8_t balance;
+        std::pair<const Key, Value> item;
+    };
+
+    // Kept at offset 0 of the file
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t nodeSize;
+        uint32_t keySize;
+        uint32_t valueSize;
+        uint64_t root;
+        uint64_t freeList;  // removed nodes, linked through their left offset
+        uint64_t used;      // end of the last node ever allocated
+        uint64_t count;
+    };
+
+    static const uint64_t kInitialFileSize = 1 << 16;
+
+    // Turning offsets into nodes and back. Pointers go stale when the file grows,
+    // which only insert can cause, and only in allocateNode before it touches any node
+    PNode* at(uint64_t offset) const;
+    uint64_t offsetOf(const PNode* n) const;
+    Header* header() const;
+    static uint64_t firstNodeOffset();
+
+    // AVLAlgorithms' view of the file: nodes found by offset, the root in the header
+    struct Links
+    {
+        typedef PNode* NodePtr;
+
+        explicit Links(PersistentAVLTree<Key, Value>* tree) : tree_(tree) {}
+
+        NodePtr parent(NodePtr n) const { return tree_->at(n->parent); }
+        NodePtr left(NodePtr n) const { return tree_->at(n->left); }
+        NodePtr right(NodePtr n) const { return tree_->at(n->right); }
+        void setParent(NodePtr n, NodePtr parent) { n->parent = tree_->offsetOf(parent); }
+        void setLeft(NodePtr n, NodePtr left) { n->left = tree_->offsetOf(left); }
+        void setRight(NodePtr n, NodePtr right) { n->right = tree_->offsetOf(right); }
+        void setRoot(NodePtr n) { tree_->header()->root = tree_->offsetOf(n); }
+        int balance(NodePtr n) const { return n->balance; }
+        void setBalance(NodePtr n, int balance) { n->balance = balance; }
+        void leftRotation(NodePtr n) { rotateLeft(*this, n); }
+        void rightRotation(NodePtr n) { rotateRight(*this, n); }
+        void countRemoveFix() {}
+
+        PersistentAVLTree<Key, Value>* tree_;
+    };
+
+    uint64_t allocateNode(const std::pair<const Key, Value>& item, uint64_t parent);
+    void freeNode(PNode* n);
+    void growTo(uint64_t minSize);
+    void mapFile(uint64_t size);
+    void checkWritable() const;
+
+    PNode* internalFind(const Key& key) const;
+    PNode* predecessor(PNode* current) const;
+    PNode* successor(PNode* current) const;
+
+    int fd_;
+    bool readOnly_;
+    char* base_;
+    uint64_t mappedSize_;
+
+private:
+    // The mapping belongs to this object
+    PersistentAVLTree(const PersistentAVLTree&);
+    PersistentAVLTree& operator=(const PersistentAVLTree&);
+};
+
+static const char kMmapTreeMagic[8] = { 'B', 'S', 'T', 'M', 'M', 'A', 'P', '1' };
+static const uint32_t kMmapTreeVersion = 1;
+
+/*
+  -------------------------------------------------
+  Begin implementations for the PersistentAVLTree::iterator class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value>
+PersistentAVLTree<Key, Value>::iterator::iterator() : tree_(nullptr), offset_(0)
+{
+
+}
+
+template<class Key, class Value>
+PersistentAVLTree<Key, Value>::iterator::iterator(const PersistentAVLTree<Key, Value>* tree, uint64_t offset) :
+    tree_(tree), offset_(offset)
+{
+
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value>& PersistentAVLTree<Key, Value>::iterator::operator*() const
+{
+    return tree_->at(offset_)->item;
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value>* PersistentAVLTree<Key, Value>::iterator::operator->() const
+{
+    return &(tree_->at(offset_)->item);
+}
+
+template<class Key, class Value>
+bool PersistentAVLTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return offset_ == rhs.offset_;
+}
+
+template<class Key, class Value>
+bool PersistentAVLTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return offset_ != rhs.offset_;
+}
+
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::iterator& PersistentAVLTree<Key, Value>::iterator::operator++()
+{
+    offset_ = tree_->offsetOf(tree_->successor(tree_->at(offset_)));
+    return *this;
+}
+
+/*
+  -------------------------------------------------
+  Begin implementations for the PersistentAVLTree class.
+  -------------------------------------------------
+*/
+
+/**
+* Maps the file at path. A missing or empty file becomes an empty tree in
+* ReadWrite mode. Throws std::runtime_error if the file cannot be opened or
+* holds something else (including a tree of other key/value types).
+*/
+template<class Key, class Value>
+PersistentAVLTree<Key, Value>::PersistentAVLTree(const std::string& path, OpenMode mode) :
+    fd_(-1), readOnly_(mode == ReadOnly), base_(nullptr), mappedSize_(0)
+{
+	fd_= open(path.c_str(), readOnly_ ? O_RDONLY : (O_RDWR | O_CREAT), 0644);
+	if (fd_<0){
+		throw std::runtime_error("cannot open " + path + ": " + strerror(errno));
+	}
+	struct stat st;
+	if (fstat(fd_, &st)!=0){
+		close(fd_);
+		throw std::runtime_error("cannot stat " + path + ": " + strerror(errno));
+	}
+
+	try{
+		if (st.st_size==0 && !readOnly_){
+			//A new tree: room for the header and some nodes
+			if (ftruncate(fd_, kInitialFileSize)!=0){
+				throw std::runtime_error("cannot grow " + path + ": " + strerror(errno));
+			}
+			mapFile(kInitialFileSize);
+			Header* h= header();
+			memcpy(h->magic, kMmapTreeMagic, sizeof(h->magic));
+			h->version=kMmapTreeVersion;
+			h->nodeSize=sizeof(PNode);
+			h->keySize=sizeof(Key);
+			h->valueSize=sizeof(Value);
+			h->root=0;
+			h->freeList=0;
+			h->used=firstNodeOffset();
+			h->count=0;
+			return;
+		}
+
+		if (static_cast<uint64_t>(st.st_size)<sizeof(Header)){
+			throw std::runtime_error(path + " is not a tree file");
+		}
+		mapFile(st.st_size);
+		Header* h= header();
+		if (memcmp(h->magic, kMmapTreeMagic, sizeof(h->magic))!=0 || h->version!=kMmapTreeVersion){
+			throw std::runtime_error(path + " is not a tree file");
+		}
+		if (h->nodeSize!=sizeof(PNode) || h->keySize!=sizeof(Key) || h->valueSize!=sizeof(Value)){
+			throw std::runtime_error(path + " holds a tree of different key or value types");
+		}
+	}catch (...){
+		if (base_!=nullptr){
+			munmap(base_, mappedSize_);
+		}
+		close(fd_);
+		throw;
+	}
+}
+
+/**
+* Unmaps the file. The kernel still writes pending changes back, call sync()
+* first if they have to be on disk now.
+*/
+template<class Key, class Value>
+PersistentAVLTree<Key, Value>::~PersistentAVLTree()
+{
+	munmap(base_, mappedSize_);
+	close(fd_);
+}
+
+template<class Key, class Value>
+void PersistentAVLTree<Key, Value>::mapFile(uint64_t size)
+{
+	int prot= readOnly_ ? PROT_READ : (PROT_READ | PROT_WRITE);
+	void* p= mmap(nullptr, size, prot, MAP_SHARED, fd_, 0);
+	if (p==MAP_FAILED){
+		throw std::runtime_error(std::string("cannot map tree file: ") + strerror(errno));
+	}
+	base_=static_cast<char*>(p);
+	mappedSize_=size;
+}
+
+/**
+* Extends the file (at least doubling it) so it is minSize bytes or more, and
+* maps it again. Every PNode pointer is stale afterwards, offsets are not.
+*/
+template<class Key, class Value>
+void PersistentAVLTree<Key, Value>::growTo(uint64_t minSize)
+{
+	uint64_t newSize= std::max(minSize, 2*mappedSize_);
+	if (ftruncate(fd_, newSize)!=0){
+		throw std::runtime_error(std::string("cannot grow tree file: ") + strerror(errno));
+	}
+	munmap(base_, mappedSize_);
+	base_=nullptr;
+	mapFile(newSize);
+}
+
+template<class Key, class Value>
+void PersistentAVLTree<Key, Value>::checkWritable() const
+{
+	if (readOnly_){
+		throw std::logic_error("tree file was opened read-only");
+	}
+}
+
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::PNode* PersistentAVLTree<Key, Value>::at(uint64_t offset) const
+{
+	return offset==0 ? nullptr : reinterpret_cast<PNode*>(base_+offset);
+}
+
+template<class Key, class Value>
+uint64_t PersistentAVLTree<Key, Value>::offsetOf(const PNode* n) const
+{
+	return n==nullptr ? 0 : reinterpret_cast<const char*>(n)-base_;
+}
+
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::Header* PersistentAVLTree<Key, Value>::header() const
+{
+	return reinterpret_cast<Header*>(base_);
+}
+
+/**
+* The header rounded up so every node is aligned like a PNode.
+*/
+template<class Key, class Value>
+uint64_t PersistentAVLTree<Key, Value>::firstNodeOffset()
+{
+	uint64_t align= alignof(PNode);
+	return (sizeof(Header)+align-1)/align*align;
+}
+
+/**
+* Takes a node from the free list, or from the end of the file (growing it if
+* needed), and fills it in. Returns an offset since the file may have moved.
+*/
+template<class Key, class Value>
+uint64_t PersistentAVLTree<Key, Value>::allocateNode(const std::pair<const Key, Value>& item, uint64_t parent)
+{
+	uint64_t offset= header()->freeList;
+	if (offset!=0){
+		header()->freeList=at(offset)->left;
+	}else{
+		if (header()->used+sizeof(PNode)>mappedSize_){
+			growTo(header()->used+sizeof(PNode));
+		}
+		offset=header()->used;
+		header()->used+=sizeof(PNode);
+	}
+	PNode* n= at(offset);
+	n->parent=parent;
+	n->left=0;
+	n->right=0;
+	n->balance=0;
+	new (&n->item) std::pair<const Key, Value>(item);
+	header()->count++;
+	return offset;
+}
+
+template<class Key, class Value>
+void PersistentAVLTree<Key, Value>::freeNode(PNode* n)
+{
+	n->left=header()->freeList;
+	header()->freeList=offsetOf(n);
+	header()->count--;
+}
+
+template<class Key, class Value>
+bool PersistentAVLTree<Key, Value>::empty() const
+{
+	return header()->root==0;
+}
+
+template<class Key, class Value>
+uint64_t PersistentAVLTree<Key, Value>::size() const
+{
+	return header()->count;
+}
+
+/**
+* Empties the tree and shrinks the file back to its initial size.
+*/
+template<class Key, class Value>
+void PersistentAVLTree<Key, Value>::clear()
+{
+	checkWritable();
+	Header* h= header();
+	h->root=0;
+	h->freeList=0;
+	h->used=firstNodeOffset();
+	h->count=0;
+	if (mappedSize_>kInitialFileSize){
+		munmap(base_, mappedSize_);
+		base_=nullptr;
+		if (ftruncate(fd_, kInitialFileSize)!=0){
+			throw std::runtime_error(std::string("cannot shrink tree file: ") + strerror(errno));
+		}
+		mapFile(kInitialFileSize);
+	}
+}
+
+template<class Key, class Value>
+void PersistentAVLTree<Key, Value>::sync()
+{
+	if (!readOnly_ && msync(base_, mappedSize_, MS_SYNC)!=0){
+		throw std::runtime_error(std::string("cannot sync tree file: ") + strerror(errno));
+	}
+}
+
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::iterator PersistentAVLTree<Key, Value>::begin() const
+{
+	PNode* n= at(header()->root);
+	while (n!=nullptr && n->left!=0){
+		n=at(n->left);
+	}
+	return iterator(this, offsetOf(n));
+}
+
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::iterator PersistentAVLTree<Key, Value>::end() const
+{
+	return iterator(this, 0);
+}
+
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::iterator PersistentAVLTree<Key, Value>::find(const Key& key) const
+{
+	return iterator(this, offsetOf(internalFind(key)));
+}
+
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::PNode* PersistentAVLTree<Key, Value>::internalFind(const Key& key) const
+{
+	PNode* temp= at(header()->root);
+	while (temp!=nullptr){
+		if (key<temp->item.first){
+			temp=at(temp->left);
+		}
+		else if (temp->item.first<key){
+			temp=at(temp->right);
+		}
+		else{
+			return temp;
+		}
+	}
+	return nullptr;
+}
+
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::PNode* PersistentAVLTree<Key, Value>::predecessor(PNode* current) const
+{
+	//The rightmost node of the left subtree, or else the first ancestor we are right of
+	if (current->left!=0){
+		PNode* temp= at(current->left);
+		while (temp->right!=0){
+			temp=at(temp->right);
+		}
+		return temp;
+	}
+	PNode* parent= at(current->parent);
+	while (parent!=nullptr && offsetOf(current)==parent->left){
+		current=parent;
+		parent=at(parent->parent);
+	}
+	return parent;
+}
+
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::PNode* PersistentAVLTree<Key, Value>::successor(PNode* current) const
+{
+	//Mirror image of predecessor
+	if (current->right!=0){
+		PNode* temp= at(current->right);
+		while (temp->left!=0){
+			temp=at(temp->left);
+		}
+		return temp;
+	}
+	PNode* parent= at(current->parent);
+	while (parent!=nullptr && offsetOf(current)==parent->right){
+		current=parent;
+		parent=at(parent->parent);
+	}
+	return parent;
+}
+
+/*
+ * If the key is already in the tree its value is overwritten, like AVLTree::insert.
+ */
+template<class Key, class Value>
+void PersistentAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& new_item)
+{
+	checkWritable();
+	const Key& keyNew=new_item.first;
+
+	//One walk down finds either the key or the parent of the new node
+	uint64_t parentOffset=0;
+	bool goLeft=false;
+	PNode* temp= at(header()->root);
+	while (temp!=nullptr){
+		if (keyNew<temp->item.first){
+			parentOffset=offsetOf(temp);
+			goLeft=true;
+			temp=at(temp->left);
+		}
+		else if (temp->item.first<keyNew){
+			parentOffset=offsetOf(temp);
+			goLeft=false;
+			temp=at(temp->right);
+		}
+		else{
+			temp->item.second=new_item.second;
+			return;
+		}
+	}
+
+	//Allocating may grow and remap the file, so we only hold offsets until it is done
+	uint64_t offset= allocateNode(new_item, parentOffset);
+	PNode* toInsert= at(offset);
+	PNode* parent= at(parentOffset);
+	Links links(this);
+	if (parent==nullptr){
+		links.setRoot(toInsert);
+		return;
+	}
+	if (goLeft){
+		links.setLeft(parent, toInsert);
+	}else{
+		links.setRight(parent, toInsert);
+	}
+	AVLAlgorithms<Links>::balanceCheck(links, toInsert);
+}
+
+/*
+ * Like AVLTree::remove, a node with two children trades places with its
+ * predecessor first. Here the items are swapped instead of the nodes, which
+ * leaves the same shape and balances.
+ */
+template<class Key, class Value>
+void PersistentAVLTree<Key, Value>::remove(const Key& key)
+{
+	checkWritable();
+	PNode* current= internalFind(key);
+	if (current==nullptr){
+		return;
+	}
+
+	if (current->left!=0 && current->right!=0){
+		PNode* pred= predecessor(current);
+		memcpy(static_cast<void*>(&current->item), &pred->item, sizeof(current->item));
+		current=pred;
+	}
+
+	Links links(this);
+	int difference;
+	PNode* parent= AVLAlgorithms<Links>::unlink(links, current, difference);
+	freeNode(current);
+
+	if (parent!=nullptr){
+		AVLAlgorithms<Links>::removeFix(links, parent, difference);
+	}
+}
+
+#endif
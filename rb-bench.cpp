@@ -0,0 +1,99 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include "avlbst.h"
+#include "rbbst.h"
+#include "bench-utils.h"
+
+using namespace std;
+
+// Head to head comparison of RBTree and AVLTree on three operation mixes.
+// Usage: ./rb-bench [numKeys] [numOps]
+// Build with DEFS=-DBST_STATS to also print the per operation counters.
+
+enum Mix { INSERT_HEAVY, DELETE_HEAVY, LOOKUP_HEAVY };
+
+static const char* mixName(Mix mix)
+{
+    if(mix == INSERT_HEAVY) return "insert-heavy";
+    if(mix == DELETE_HEAVY) return "delete-heavy";
+    return "lookup-heavy";
+}
+
+// Percentages of insert/remove, the rest of the operations are finds
+static void mixShape(Mix mix, unsigned& insertPct, unsigned& removePct)
+{
+    if(mix == INSERT_HEAVY) { insertPct = 80; removePct = 10; }
+    else if(mix == DELETE_HEAVY) { insertPct = 35; removePct = 55; }
+    else { insertPct = 5; removePct = 5; }
+}
+
+void printStats(const char* name, Mix mix, const TreeStats& stats)
+{
+#ifdef BST_STATS
+    double ops = stats.operations;
+    cerr << mixName(mix) << " " << name << ": comparisons/op " << stats.comparisons / ops
+         << ", nodes/op " << stats.nodesVisited / ops
+         << ", rotations/op " << stats.rotations / ops
+         << ", swaps/op " << stats.nodeSwaps / ops
+         << ", removeFix steps/op " << stats.removeFixCalls / ops
+         << " (max " << stats.maxRemoveFixDepth << ")"
+         << ", allocations/op " << stats.allocations / ops << endl;
+#endif
+}
+
+template<typename Tree>
+double runMix(const char* name, Mix mix, uint64_t numKeys, uint64_t numOps)
+{
+    Tree tree;
+    // The insert heavy mix starts empty, the others start from a full tree
+    if(mix != INSERT_HEAVY) {
+        vector<uint64_t> keys = shuffledKeys(numKeys, 1);
+        for(size_t i = 0; i < keys.size(); ++i) {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+    }
+
+    unsigned insertPct, removePct;
+    mixShape(mix, insertPct, removePct);
+    BenchRandom rng(2);
+    uint64_t found = 0;
+    tree.reset_stats();
+
+    BenchTimer timer;
+    for(uint64_t i = 0; i < numOps; ++i) {
+        uint64_t key = rng.below(numKeys);
+        unsigned op = rng.below(100);
+        if(op < insertPct) {
+            tree.insert(make_pair(key, i));
+        }
+        else if(op < insertPct + removePct) {
+            tree.remove(key);
+        }
+        else {
+            found += (tree.find(key) != tree.end());
+        }
+    }
+    double secs = timer.elapsedSec();
+    benchKeep(found);
+    printStats(name, mix, tree.stats());
+    return secs;
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t numKeys = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    uint64_t numOps = argc > 2 ? strtoull(argv[2], NULL, 10) : 2000000;
+
+    cout << "mix,tree,keys,ops,seconds,mops_per_sec" << endl;
+    Mix mixes[] = { INSERT_HEAVY, DELETE_HEAVY, LOOKUP_HEAVY };
+    for(int m = 0; m < 3; ++m) {
+        double avl = runMix<AVLTree<uint64_t, uint64_t> >("AVLTree", mixes[m], numKeys, numOps);
+        double rb = runMix<RBTree<uint64_t, uint64_t> >("RBTree", mixes[m], numKeys, numOps);
+        cout << mixName(mixes[m]) << ",AVLTree," << numKeys << "," << numOps << ","
+             << avl << "," << numOps / avl / 1e6 << endl;
+        cout << mixName(mixes[m]) << ",RBTree," << numKeys << "," << numOps << ","
+             << rb << "," << numOps / rb / 1e6 << endl;
+    }
+    return 0;
+}
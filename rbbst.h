@@ -0,0 +1,496 @@
+#ifndef RBBST_H
+#define RBBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include "bst.h"
+
+/**
+* The two colors a red black node can take.
+*/
+enum class RBColor : int8_t { Red, Black };
+
+/**
+* A special kind of node for a red black tree, which adds the color as a data member.
+*/
+template <typename Key, typename Value>
+class RBNode : public Node<Key, Value>
+{
+public:
+    // Constructor/destructor.
+    RBNode(const Key& key, const Value& value, RBNode<Key, Value>* parent, TreeMemoryResource* resource = NULL);
+    virtual ~RBNode();
+
+    // Getter/setter for the node's color.
+    RBColor getColor () const;
+    void setColor (RBColor color);
+    bool isRed() const;
+
+    // Getters for parent, left, and right. These need to be redefined since they
+    // return pointers to RBNodes - not plain Nodes. See the Node class in bst.h
+    // for more information.
+    virtual RBNode<Key, Value>* getParent() const override;
+    virtual RBNode<Key, Value>* getLeft() const override;
+    virtual RBNode<Key, Value>* getRight() const override;
+
+protected:
+    RBColor color_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the RBNode class.
+  -------------------------------------------------
+*/
+
+/**
+* An explicit constructor. New nodes always start out red.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>::RBNode(const Key& key, const Value& value, RBNode<Key, Value> *parent, TreeMemoryResource* resource) :
+    Node<Key, Value>(key, value, parent, resource), color_(RBColor::Red)
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>::~RBNode()
+{
+
+}
+
+/**
+* A getter for the color of a RBNode.
+*/
+template<class Key, class Value>
+RBColor RBNode<Key, Value>::getColor() const
+{
+    return color_;
+}
+
+/**
+* A setter for the color of a RBNode.
+*/
+template<class Key, class Value>
+void RBNode<Key, Value>::setColor(RBColor color)
+{
+    color_ = color;
+}
+
+/**
+* Returns true if the node is red.
+*/
+template<class Key, class Value>
+bool RBNode<Key, Value>::isRed() const
+{
+    return color_ == RBColor::Red;
+}
+
+/**
+* An overridden function for getting the parent since a static_cast is necessary to make sure
+* that our node is a RBNode.
+*/
+template<class Key, class Value>
+RBNode<Key, Value> *RBNode<Key, Value>::getParent() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->parent_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class Key, class Value>
+RBNode<Key, Value> *RBNode<Key, Value>::getLeft() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->left_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class Key, class Value>
+RBNode<Key, Value> *RBNode<Key, Value>::getRight() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->right_);
+}
+
+
+/*
+  -----------------------------------------------
+  End implementations for the RBNode class.
+  -----------------------------------------------
+*/
+
+
+/**
+* A red black tree. Insert does at most 2 rotations and remove at most 3,
+* the rest of the fixing up is done by recoloring.
+*/
+template <class Key, class Value>
+class RBTree : public BinarySearchTree<Key, Value>
+{
+public:
+    explicit RBTree(TreeMemoryResource* resource = NULL);
+    RBTree(const RBTree<Key, Value>& other);
+    RBTree(RBTree<Key, Value>&& other) noexcept;
+    RBTree<Key, Value>& operator=(const RBTree<Key, Value>& other);
+    RBTree<Key, Value>& operator=(RBTree<Key, Value>&& other) noexcept;
+    virtual void insert (const std::pair<const Key, Value> &new_item);
+    virtual void remove(const Key& key);
+protected:
+    virtual void nodeSwap( RBNode<Key,Value>* n1, RBNode<Key,Value>* n2);
+
+    // Helper functions
+		void insertFix(RBNode<Key, Value> *current);
+		void removeFix(RBNode<Key, Value> *current, RBNode<Key, Value> *parent);
+		static bool isRed(RBNode<Key, Value> *n);
+		virtual Node<Key, Value>* newTreeNode(const Key& key, const Value& value, Node<Key, Value>* parent);
+		virtual void finishBuiltNode(Node<Key, Value>* n, int leftHeight, int rightHeight, bool deepestLevel);
+		virtual Node<Key, Value>* cloneNode(const Node<Key, Value>* source, Node<Key, Value>* parent);
+		using BinarySearchTree<Key, Value>::leftRotation;
+		using BinarySearchTree<Key, Value>::rightRotation;
+};
+
+template<class Key, class Value>
+RBTree<Key, Value>::RBTree(TreeMemoryResource* resource) : BinarySearchTree<Key, Value>(resource)
+{
+
+}
+
+/**
+* Copy constructor, the copy has the same shape and colors as other.
+*/
+template<class Key, class Value>
+RBTree<Key, Value>::RBTree(const RBTree<Key, Value>& other) : BinarySearchTree<Key, Value>()
+{
+	//Copied here rather than by the base copy constructor, where cloneNode would not make RBNodes yet
+	this->copyFrom(other);
+}
+
+template<class Key, class Value>
+RBTree<Key, Value>::RBTree(RBTree<Key, Value>&& other) noexcept : BinarySearchTree<Key, Value>(std::move(other))
+{
+
+}
+
+template<class Key, class Value>
+RBTree<Key, Value>& RBTree<Key, Value>::operator=(const RBTree<Key, Value>& other)
+{
+	BinarySearchTree<Key, Value>::operator=(other);
+	return *this;
+}
+
+template<class Key, class Value>
+RBTree<Key, Value>& RBTree<Key, Value>::operator=(RBTree<Key, Value>&& other) noexcept
+{
+	BinarySearchTree<Key, Value>::operator=(std::move(other));
+	return *this;
+}
+
+/**
+* Copies make RBNodes with the color of the node they copy.
+*/
+template<class Key, class Value>
+Node<Key, Value>* RBTree<Key, Value>::cloneNode(const Node<Key, Value>* source, Node<Key, Value>* parent)
+{
+	RBNode<Key, Value> *copy= this->template makeNode<RBNode<Key, Value> >(source->getKey(), source->getValue(),
+		static_cast<RBNode<Key,Value>*>(parent));
+	copy->setColor(static_cast<const RBNode<Key,Value>*>(source)->getColor());
+	return copy;
+}
+
+/**
+* Null children count as black leaves.
+*/
+template<class Key, class Value>
+bool RBTree<Key, Value>::isRed(RBNode<Key, Value> *n)
+{
+	return n!=nullptr && n->isRed();
+}
+
+/**
+* load() builds the tree out of RBNodes.
+*/
+template<class Key, class Value>
+Node<Key, Value>* RBTree<Key, Value>::newTreeNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+	return this->template makeNode<RBNode<Key, Value> >(key, value, static_cast<RBNode<Key,Value>*>(parent));
+}
+
+/**
+* A tree built by load() has all its empty links on the last two levels. Making
+* every node black except the deepest level (red when the tree has more than one
+* level) gives every path the same number of black nodes.
+*/
+template<class Key, class Value>
+void RBTree<Key, Value>::finishBuiltNode(Node<Key, Value>* n, int, int, bool deepestLevel)
+{
+	static_cast<RBNode<Key,Value>*>(n)->setColor(deepestLevel ? RBColor::Red : RBColor::Black);
+}
+
+/*
+ * If key is already in the tree, the current value is overwritten
+ * with the updated value.
+ */
+template<class Key, class Value>
+void RBTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+{
+	BST_COUNT(operations, 1);
+	const Key& keyNew=new_item.first;
+
+	//Unlike the AVL tree we only walk down once, looking for the key and the insertion point together
+	RBNode<Key, Value> *temp= static_cast<RBNode<Key,Value>*>(this->root_);
+	RBNode<Key, Value> *parent= nullptr;
+	while (temp!=nullptr){
+		parent=temp;
+		BST_COUNT(nodesVisited, 1);
+		BST_COUNT(comparisons, 1);
+		if (keyNew<temp->getKey()){
+			temp=temp->getLeft();
+		}
+		else if (BST_COUNT(comparisons, 1), temp->getKey()<keyNew){
+			temp=temp->getRight();
+		}
+		else{ //If KEY found we update the VALUE and are done
+			temp->setValue(new_item.second);
+			return;
+		}
+	}
+
+	RBNode<Key, Value> *toInsert= this->template makeNode<RBNode<Key, Value> >(keyNew, new_item.second, parent);
+	if (parent==nullptr){
+		this->root_=toInsert;
+	}
+	else if (keyNew<parent->getKey()){
+		parent->setLeft(toInsert);
+	}else{
+		parent->setRight(toInsert);
+	}
+
+	insertFix(toInsert);
+}
+
+/**
+* Restores the red black properties after current (a red node) was attached.
+* Red uncles are handled by recoloring and moving up, otherwise one single or
+* one double rotation finishes the job.
+*/
+template<class Key, class Value>
+void RBTree<Key, Value>::insertFix(RBNode<Key, Value> *current)
+{
+	while (isRed(current->getParent())){
+		RBNode<Key, Value> *parent= current->getParent();
+		RBNode<Key, Value> *grandParent= parent->getParent(); //A red parent is never the root, so this exists
+
+		if (parent==grandParent->getLeft()){
+			RBNode<Key, Value> *uncle= grandParent->getRight();
+
+			//CASE 1: red uncle, we recolor and keep checking from the grandparent
+			if (isRed(uncle)){
+				parent->setColor(RBColor::Black);
+				uncle->setColor(RBColor::Black);
+				grandParent->setColor(RBColor::Red);
+				current=grandParent;
+				continue;
+			}
+
+			//CASE 2: LR zig-zag, we turn it into the LL case
+			if (current==parent->getRight()){
+				leftRotation(parent);
+				std::swap(current, parent);
+			}
+
+			//CASE 3: LL
+			rightRotation(grandParent);
+			parent->setColor(RBColor::Black);
+			grandParent->setColor(RBColor::Red);
+			break;
+		}
+		else{
+			RBNode<Key, Value> *uncle= grandParent->getLeft();
+
+			//Mirror image of the cases above
+			if (isRed(uncle)){
+				parent->setColor(RBColor::Black);
+				uncle->setColor(RBColor::Black);
+				grandParent->setColor(RBColor::Red);
+				current=grandParent;
+				continue;
+			}
+
+			if (current==parent->getLeft()){
+				rightRotation(parent);
+				std::swap(current, parent);
+			}
+
+			leftRotation(grandParent);
+			parent->setColor(RBColor::Black);
+			grandParent->setColor(RBColor::Red);
+			break;
+		}
+	}
+
+	//The root is always black
+	static_cast<RBNode<Key,Value>*>(this->root_)->setColor(RBColor::Black);
+}
+
+/*
+ * Like the other trees, if a node has 2 children we
+ * swap with the predecessor and then remove.
+ */
+template<class Key, class Value>
+void RBTree<Key, Value>::remove(const Key& key)
+{
+	BST_COUNT(operations, 1);
+	RBNode<Key, Value> *current=static_cast<RBNode<Key,Value>*>(this->internalFind(key));
+
+	//CASE 1: node does not exist
+	if (current==nullptr){
+		return;
+	}
+
+	//CASE 2: There are two children, after the swap current has at most one child
+	if (current->getLeft()!=nullptr && current->getRight()!=nullptr){
+		RBNode<Key, Value> *predecessor=static_cast<RBNode<Key,Value>*>(this->predecessor(current));
+		nodeSwap(current, predecessor);
+	}
+
+	RBNode<Key, Value> *parent= current->getParent();
+	RBNode<Key, Value> *child= current->getLeft();
+	if (child==nullptr){
+		child=current->getRight();
+	}
+
+	//Splicing current out of the tree
+	if (child!=nullptr){
+		child->setParent(parent);
+	}
+	if (parent==nullptr){
+		this->root_=child;
+	}
+	else if (parent->getLeft()==current){
+		parent->setLeft(child);
+	}else{
+		parent->setRight(child);
+	}
+
+	//Removing a red node never changes the black heights. Otherwise a red child can
+	//take over the black, and only a black (or missing) child leaves a double black to fix
+	bool removedBlack= !current->isRed();
+	this->freeNode(current);
+
+	if (removedBlack){
+		if (isRed(child)){
+			child->setColor(RBColor::Black);
+		}else{
+#ifdef BST_STATS
+			uint64_t callsBefore= this->stats_.removeFixCalls;
+			removeFix(child, parent);
+			this->stats_.maxRemoveFixDepth= std::max(this->stats_.maxRemoveFixDepth, this->stats_.removeFixCalls-callsBefore);
+#else
+			removeFix(child, parent);
+#endif
+		}
+	}
+}
+
+/**
+* Pushes the missing black of the "double black" current upwards until it can be
+* absorbed. current may be NULL, which is why its parent is passed separately.
+*/
+template<class Key, class Value>
+void RBTree<Key, Value>::removeFix(RBNode<Key, Value> *current, RBNode<Key, Value> *parent)
+{
+	while (parent!=nullptr && !isRed(current)){
+		BST_COUNT(removeFixCalls, 1);
+		if (current==parent->getLeft()){
+			RBNode<Key, Value> *sibling= parent->getRight(); //The black height guarantees the sibling exists
+
+			//CASE 1: red sibling, rotate so that the sibling becomes black
+			if (isRed(sibling)){
+				sibling->setColor(RBColor::Black);
+				parent->setColor(RBColor::Red);
+				leftRotation(parent);
+				sibling=parent->getRight();
+			}
+
+			//CASE 2: both nephews black, recolor and move the problem up
+			if (!isRed(sibling->getLeft()) && !isRed(sibling->getRight())){
+				sibling->setColor(RBColor::Red);
+				current=parent;
+				parent=current->getParent();
+				continue;
+			}
+
+			//CASE 3: only the near nephew is red, turn it into case 4
+			if (!isRed(sibling->getRight())){
+				sibling->getLeft()->setColor(RBColor::Black);
+				sibling->setColor(RBColor::Red);
+				rightRotation(sibling);
+				sibling=parent->getRight();
+			}
+
+			//CASE 4: far nephew is red, one rotation finishes it
+			sibling->setColor(parent->getColor());
+			parent->setColor(RBColor::Black);
+			sibling->getRight()->setColor(RBColor::Black);
+			leftRotation(parent);
+			current=static_cast<RBNode<Key,Value>*>(this->root_);
+			break;
+		}
+		else{
+			RBNode<Key, Value> *sibling= parent->getLeft();
+
+			//Mirror image of the cases above
+			if (isRed(sibling)){
+				sibling->setColor(RBColor::Black);
+				parent->setColor(RBColor::Red);
+				rightRotation(parent);
+				sibling=parent->getLeft();
+			}
+
+			if (!isRed(sibling->getLeft()) && !isRed(sibling->getRight())){
+				sibling->setColor(RBColor::Red);
+				current=parent;
+				parent=current->getParent();
+				continue;
+			}
+
+			if (!isRed(sibling->getLeft())){
+				sibling->getRight()->setColor(RBColor::Black);
+				sibling->setColor(RBColor::Red);
+				leftRotation(sibling);
+				sibling=parent->getLeft();
+			}
+
+			sibling->setColor(parent->getColor());
+			parent->setColor(RBColor::Black);
+			sibling->getLeft()->setColor(RBColor::Black);
+			rightRotation(parent);
+			current=static_cast<RBNode<Key,Value>*>(this->root_);
+			break;
+		}
+	}
+
+	if (current!=nullptr){
+		current->setColor(RBColor::Black);
+	}
+}
+
+template<class Key, class Value>
+void RBTree<Key, Value>::nodeSwap( RBNode<Key,Value>* n1, RBNode<Key,Value>* n2)
+{
+    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
+    RBColor tempC = n1->getColor();
+    n1->setColor(n2->getColor());
+    n2->setColor(tempC);
+}
+
+
+#endif
@@ -0,0 +1,98 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include "avlbst.h"
+#include "latency-histogram.h"
+#include "bench-utils.h"
+
+using namespace std;
+
+// A burst of inserts into a large AVLTree, rebalanced as usual and in relaxed
+// mode (see setRelaxedBalance), with random keys and with appends of
+// increasing keys. Reports the insert latency during the burst, random
+// lookups while the rebalancing is still pending and after it is done, and
+// what rebalance_pending() costs per queued insert.
+// Usage: ./relaxed-bench [treeSize] [burstSize] [numLookups]
+
+enum Measure { INSERT_MEAN, INSERT_P99, LOOKUP_PENDING, SETTLE, LOOKUP_AFTER };
+
+struct RunBurst
+{
+    RunBurst(bool r, bool a, Measure m, uint64_t n, uint64_t b, uint64_t l) :
+        relaxed(r), append(a), measure(m), treeSize(n), burstSize(b), numLookups(l) {}
+
+    // Returns ns for the measure, per insert or per lookup
+    double operator()() const
+    {
+        AVLTree<uint64_t, uint64_t> tree;
+        BenchRandom rng(1);
+        // Keys are even so the random burst adds new ones, appends go past the end
+        for(uint64_t i = 0; i < treeSize; ++i) {
+            tree.insert(make_pair(2 * rng.below(4 * treeSize), i));
+        }
+        tree.setRelaxedBalance(relaxed);
+
+        LatencyHistogram latency;
+        BenchTimer total;
+        for(uint64_t i = 0; i < burstSize; ++i) {
+            uint64_t key = append ? 8 * treeSize + i : 2 * rng.below(4 * treeSize) + 1;
+            BenchTimer timer;
+            tree.insert(make_pair(key, i));
+            latency.record(timer.elapsedNs());
+        }
+        double burstNs = total.elapsedNs();
+        if(measure == INSERT_MEAN) return burstNs / burstSize;
+        if(measure == INSERT_P99) return latency.percentile(99);
+
+        if(measure == LOOKUP_PENDING) return lookups(tree, rng);
+        BenchTimer settle;
+        tree.rebalance_pending();
+        double settleNs = settle.elapsedNs();
+        if(measure == SETTLE) return settleNs / burstSize;
+        return lookups(tree, rng);
+    }
+
+    // Random lookups over the whole key range, the burst's keys included
+    double lookups(const AVLTree<uint64_t, uint64_t>& tree, BenchRandom& rng) const
+    {
+        uint64_t range = 8 * treeSize + burstSize;
+        uint64_t found = 0;
+        BenchTimer timer;
+        for(uint64_t i = 0; i < numLookups; ++i) {
+            found += (tree.find(rng.below(range)) != tree.end());
+        }
+        double ns = timer.elapsedNs();
+        benchKeep(found);
+        return ns / numLookups;
+    }
+
+    bool relaxed;
+    bool append;
+    Measure measure;
+    uint64_t treeSize;
+    uint64_t burstSize;
+    uint64_t numLookups;
+};
+
+int main(int argc, char *argv[])
+{
+    uint64_t treeSize = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    uint64_t burstSize = argc > 2 ? strtoull(argv[2], NULL, 10) : 100000;
+    uint64_t numLookups = argc > 3 ? strtoull(argv[3], NULL, 10) : 1000000;
+
+    cout << "keys,mode,insert_mean_ns,insert_p99_ns,lookup_pending_ns,settle_ns,lookup_after_ns" << endl;
+    for(int append = 0; append <= 1; ++append) {
+        for(int relaxed = 0; relaxed <= 1; ++relaxed) {
+            cout << (append ? "append" : "random") << "," << (relaxed ? "relaxed" : "balanced");
+            for(int m = INSERT_MEAN; m <= LOOKUP_AFTER; ++m) {
+                if(!relaxed && (m == LOOKUP_PENDING || m == SETTLE)) {
+                    cout << ",";
+                    continue;
+                }
+                cout << "," << runIsolated(RunBurst(relaxed, append, Measure(m), treeSize, burstSize, numLookups));
+            }
+            cout << endl;
+        }
+    }
+    return 0;
+}
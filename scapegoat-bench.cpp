@@ -0,0 +1,79 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include "avlbst.h"
+#include "bench-utils.h"
+
+using namespace std;
+
+// Sorted inserts followed by random lookups, the input that turns the plain
+// BinarySearchTree into a list: as is, in scapegoat mode (see
+// setScapegoatAlpha), as is with one rebalance() after the inserts, and an
+// AVLTree for comparison.
+// Usage: ./scapegoat-bench [maxKeys] [alpha]
+
+enum TreeKind { PLAIN, SCAPEGOAT, REBALANCE, AVL };
+
+struct RunSorted
+{
+    RunSorted(TreeKind k, uint64_t n, double a, bool l) : kind(k), numKeys(n), alpha(a), lookups(l) {}
+
+    // Returns ns per insert, or per lookup if lookups is set
+    double operator()() const
+    {
+        BinarySearchTree<uint64_t, uint64_t> plain;
+        AVLTree<uint64_t, uint64_t> avl;
+        BinarySearchTree<uint64_t, uint64_t>& tree = kind == AVL ? avl : plain;
+        if(kind == SCAPEGOAT) {
+            plain.setScapegoatAlpha(alpha);
+        }
+        BenchTimer timer;
+        for(uint64_t i = 0; i < numKeys; ++i) {
+            tree.insert(make_pair(i, i));
+        }
+        if(kind == REBALANCE) {
+            tree.rebalance();
+        }
+        double insertNs = timer.elapsedNs();
+        if(!lookups) {
+            return insertNs / numKeys;
+        }
+        BenchRandom rng(1);
+        uint64_t found = 0;
+        timer.restart();
+        for(uint64_t i = 0; i < numKeys; ++i) {
+            found += (tree.find(rng.below(numKeys)) != tree.end());
+        }
+        double ns = timer.elapsedNs();
+        benchKeep(found);
+        return ns / numKeys;
+    }
+
+    TreeKind kind;
+    uint64_t numKeys;
+    double alpha;
+    bool lookups;
+};
+
+int main(int argc, char *argv[])
+{
+    uint64_t maxKeys = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    double alpha = argc > 2 ? atof(argv[2]) : 0.7;
+
+    cout << "keys,plain_insert_ns,plain_find_ns,scapegoat_insert_ns,scapegoat_find_ns,"
+         << "rebalance_insert_ns,rebalance_find_ns,avl_insert_ns,avl_find_ns" << endl;
+    for(uint64_t n = 1000; n <= maxKeys; n *= 10) {
+        cout << n;
+        for(int kind = PLAIN; kind <= AVL; ++kind) {
+            // The plain tree is quadratic on sorted input, stop it early
+            if((kind == PLAIN || kind == REBALANCE) && n > 20000) {
+                cout << ",,";
+                continue;
+            }
+            cout << "," << runIsolated(RunSorted(TreeKind(kind), n, alpha, false))
+                 << "," << runIsolated(RunSorted(TreeKind(kind), n, alpha, true));
+        }
+        cout << endl;
+    }
+    return 0;
+}
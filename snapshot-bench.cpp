@@ -0,0 +1,65 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include "avlbst.h"
+#include "bench-utils.h"
+
+using namespace std;
+
+// Restart cost of an AVLTree: re-inserting every entry from a text dump
+// versus load() of a binary snapshot written by save().
+// Usage: ./snapshot-bench [numKeys] [directory for the dump files]
+
+typedef AVLTree<uint64_t, uint64_t> AVL;
+
+int main(int argc, char *argv[])
+{
+    uint64_t numKeys = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+    string dir = argc > 2 ? argv[2] : "/tmp";
+    string textPath = dir + "/bst-bench-dump.txt";
+    string binPath = dir + "/bst-bench-dump.bin";
+
+    {
+        AVL tree;
+        vector<uint64_t> keys = shuffledKeys(numKeys, 1);
+        for(size_t i = 0; i < keys.size(); ++i) {
+            tree.insert(make_pair(keys[i] * 7919, keys[i]));
+        }
+
+        ofstream text(textPath.c_str());
+        for(AVL::iterator it = tree.begin(); it != tree.end(); ++it) {
+            text << it->first << " " << it->second << "\n";
+        }
+
+        BenchTimer timer;
+        ofstream bin(binPath.c_str(), ios::binary);
+        tree.save(bin);
+        bin.close();
+        cout << "save: " << timer.elapsedSec() << " s" << endl;
+    }
+
+    BenchTimer timer;
+    {
+        AVL tree;
+        ifstream text(textPath.c_str());
+        uint64_t key, value;
+        while(text >> key >> value) {
+            tree.insert(make_pair(key, value));
+        }
+        cout << "text dump + insert: " << timer.elapsedSec() << " s" << endl;
+    }
+
+    timer.restart();
+    {
+        AVL tree;
+        ifstream bin(binPath.c_str(), ios::binary);
+        tree.load(bin);
+        cout << "binary load: " << timer.elapsedSec() << " s (balanced: " << tree.isBalanced() << ")" << endl;
+    }
+
+    remove(textPath.c_str());
+    remove(binPath.c_str());
+    return 0;
+}
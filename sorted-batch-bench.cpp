@@ -0,0 +1,88 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include "avlbst.h"
+#include "bench-utils.h"
+
+using namespace std;
+
+// Sorted batches against an AVLTree of numKeys entries: one find/insert per
+// key from the root versus find_sorted/insert_sorted, which resume from the
+// previous key. The gain grows as batches get denser (k close to n).
+// Usage: ./sorted-batch-bench [numKeys]
+
+typedef AVLTree<uint64_t, uint64_t> AVL;
+
+enum Mode { FIND, FIND_SORTED, INSERT, INSERT_SORTED };
+
+struct RunBatch
+{
+    RunBatch(Mode m, uint64_t n, uint64_t k) : mode(m), numKeys(n), batch(k) {}
+
+    double operator()() const
+    {
+        // Even keys are in the tree, the batch mixes hits and misses (odd keys)
+        AVL tree;
+        vector<uint64_t> keys = shuffledKeys(numKeys, 1);
+        for(size_t i = 0; i < keys.size(); ++i) {
+            tree.insert(make_pair(2 * keys[i], keys[i]));
+        }
+        BenchRandom rng(batch);
+        vector<uint64_t> wanted(batch);
+        for(size_t i = 0; i < wanted.size(); ++i) {
+            wanted[i] = rng.below(2 * numKeys);
+        }
+        sort(wanted.begin(), wanted.end());
+        vector<pair<const uint64_t, uint64_t> > items;
+        items.reserve(batch);
+        for(size_t i = 0; i < wanted.size(); ++i) {
+            items.push_back(make_pair(wanted[i], i));
+        }
+        vector<AVL::iterator> results(batch);
+        tree.reset_stats();
+
+        BenchTimer timer;
+        if(mode == FIND) {
+            for(size_t i = 0; i < wanted.size(); ++i) results[i] = tree.find(wanted[i]);
+        }
+        else if(mode == FIND_SORTED) {
+            tree.find_sorted(&wanted[0], wanted.size(), &results[0]);
+        }
+        else if(mode == INSERT) {
+            for(size_t i = 0; i < items.size(); ++i) tree.insert(items[i]);
+        }
+        else {
+            tree.insert_sorted(&items[0], items.size());
+        }
+        double secs = timer.elapsedSec();
+        benchKeep(results[batch / 2] != tree.end());
+#ifdef BST_STATS
+        cerr << "  nodes visited per key: " << double(tree.stats().nodesVisited) / batch << endl;
+#endif
+        return secs;
+    }
+
+    Mode mode;
+    uint64_t numKeys;
+    uint64_t batch;
+};
+
+int main(int argc, char *argv[])
+{
+    uint64_t numKeys = argc > 1 ? strtoull(argv[1], NULL, 10) : 2000000;
+    const char* names[] = { "find", "find_sorted", "insert", "insert_sorted" };
+
+    cout << "keys,batch,method,seconds,ns_per_key,speedup" << endl;
+    for(uint64_t batch = 1000; batch <= numKeys; batch *= 10) {
+        for(int m = 0; m < 4; m += 2) {
+            double plain = runIsolated(RunBatch(static_cast<Mode>(m), numKeys, batch));
+            double sorted = runIsolated(RunBatch(static_cast<Mode>(m + 1), numKeys, batch));
+            cout << numKeys << "," << batch << "," << names[m] << "," << plain << ","
+                 << plain / batch * 1e9 << ",1" << endl;
+            cout << numKeys << "," << batch << "," << names[m + 1] << "," << sorted << ","
+                 << sorted / batch * 1e9 << "," << plain / sorted << endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include "avlbst.h"
+#include "splaybst.h"
+#include "bench-utils.h"
+
+using namespace std;
+
+// Replays Zipf distributed lookup traces against AVLTree, SplayTree and
+// the semi-splay variant, and reports per lookup latency percentiles.
+// Usage: ./splay-bench [numKeys] [numLookups]
+
+template<typename Tree>
+void replay(const char* name, Tree& tree, const vector<uint64_t>& trace,
+            uint64_t numKeys, double exponent)
+{
+    vector<uint64_t> samples(trace.size());
+    uint64_t found = 0;
+    BenchTimer total;
+    for(size_t i = 0; i < trace.size(); ++i) {
+        BenchTimer timer;
+        found += (tree.find(trace[i]) != tree.end());
+        samples[i] = timer.elapsedNs();
+    }
+    double secs = total.elapsedSec();
+    benchKeep(found);
+
+    sort(samples.begin(), samples.end());
+    cout << name << "," << numKeys << "," << exponent << "," << trace.size() << ","
+         << trace.size() / secs / 1e6 << ","
+         << percentile(samples, 50) << "," << percentile(samples, 90) << ","
+         << percentile(samples, 99) << "," << percentile(samples, 99.9) << ","
+         << samples.back() << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t numKeys = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    uint64_t numLookups = argc > 2 ? strtoull(argv[2], NULL, 10) : 2000000;
+
+    // Hot ranks are spread over the key space instead of being the smallest keys
+    vector<uint64_t> keys = shuffledKeys(numKeys, 1);
+    AVLTree<uint64_t, uint64_t> avl;
+    SplayTree<uint64_t, uint64_t> splay;
+    SplayTree<uint64_t, uint64_t> semi(true);
+    vector<uint64_t> order = shuffledKeys(numKeys, 3);
+    for(size_t i = 0; i < order.size(); ++i) {
+        avl.insert(make_pair(order[i], order[i]));
+        splay.insert(make_pair(order[i], order[i]));
+        semi.insert(make_pair(order[i], order[i]));
+    }
+
+    cout << "tree,keys,zipf_s,lookups,mops_per_sec,p50_ns,p90_ns,p99_ns,p999_ns,max_ns" << endl;
+    double exponents[] = { 0.8, 0.99, 1.2 };
+    for(int e = 0; e < 3; ++e) {
+        ZipfGenerator zipf(numKeys, exponents[e]);
+        BenchRandom rng(4 + e);
+        vector<uint64_t> trace(numLookups);
+        for(size_t i = 0; i < trace.size(); ++i) {
+            trace[i] = keys[zipf.next(rng) - 1];
+        }
+        replay("AVLTree", avl, trace, numKeys, exponents[e]);
+        replay("SplayTree", splay, trace, numKeys, exponents[e]);
+        replay("SplayTree-semi", semi, trace, numKeys, exponents[e]);
+    }
+    return 0;
+}
@@ -0,0 +1,331 @@
+#ifndef SPLAYBST_H
+#define SPLAYBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <stdexcept>
+#include "bst.h"
+
+/**
+* A splay tree. Every access moves the accessed node to the root using the
+* rotations from BinarySearchTree, so frequently used keys stay near the top.
+* Splay trees need no extra data in the node, so the plain Node is used.
+*
+* In semi-splay mode the zig-zig case only rotates the grandparent and then
+* continues from the parent. The accessed node ends up about halfway to the
+* root instead of at the root, which restructures the tree a lot less.
+*/
+template <class Key, class Value>
+class SplayTree : public BinarySearchTree<Key, Value>
+{
+public:
+    explicit SplayTree(bool semiSplay = false, TreeMemoryResource* resource = NULL);
+    explicit SplayTree(TreeMemoryResource* resource);
+    SplayTree(const SplayTree<Key, Value>& other);
+    SplayTree(SplayTree<Key, Value>&& other) noexcept;
+    SplayTree<Key, Value>& operator=(const SplayTree<Key, Value>& other);
+    SplayTree<Key, Value>& operator=(SplayTree<Key, Value>&& other) noexcept;
+    virtual void insert (const std::pair<const Key, Value> &new_item);
+    virtual void remove(const Key& key);
+
+    // Lookups splay too, so they hide the const versions in BinarySearchTree
+    typename BinarySearchTree<Key, Value>::iterator find(const Key& key);
+    using BinarySearchTree<Key, Value>::find;
+    Value& operator[](const Key& key);
+    using BinarySearchTree<Key, Value>::operator[];
+
+    void setSemiSplay(bool semiSplay);
+    bool isSemiSplay() const;
+
+protected:
+    // Helper functions
+		Node<Key, Value>* splayFind(const Key& key);
+		void splay(Node<Key, Value> *current);
+		using BinarySearchTree<Key, Value>::leftRotation;
+		using BinarySearchTree<Key, Value>::rightRotation;
+
+		bool semiSplay_;
+};
+
+/**
+* Constructor, a full splay tree unless semiSplay is set.
+*/
+template<class Key, class Value>
+SplayTree<Key, Value>::SplayTree(bool semiSplay, TreeMemoryResource* resource) :
+    BinarySearchTree<Key, Value>(resource), semiSplay_(semiSplay)
+{
+
+}
+
+/**
+* A full splay tree on resource, like the other trees take it. Without this
+* a pointer would convert to the semiSplay flag.
+*/
+template<class Key, class Value>
+SplayTree<Key, Value>::SplayTree(TreeMemoryResource* resource) :
+    BinarySearchTree<Key, Value>(resource), semiSplay_(false)
+{
+
+}
+
+/**
+* Copy constructor, the copy has the same shape (and so the same hot nodes near the root).
+*/
+template<class Key, class Value>
+SplayTree<Key, Value>::SplayTree(const SplayTree<Key, Value>& other) :
+    BinarySearchTree<Key, Value>(other), semiSplay_(other.semiSplay_)
+{
+
+}
+
+template<class Key, class Value>
+SplayTree<Key, Value>::SplayTree(SplayTree<Key, Value>&& other) noexcept :
+    BinarySearchTree<Key, Value>(std::move(other)), semiSplay_(other.semiSplay_)
+{
+
+}
+
+template<class Key, class Value>
+SplayTree<Key, Value>& SplayTree<Key, Value>::operator=(const SplayTree<Key, Value>& other)
+{
+	BinarySearchTree<Key, Value>::operator=(other);
+	semiSplay_=other.semiSplay_;
+	return *this;
+}
+
+template<class Key, class Value>
+SplayTree<Key, Value>& SplayTree<Key, Value>::operator=(SplayTree<Key, Value>&& other) noexcept
+{
+	BinarySearchTree<Key, Value>::operator=(std::move(other));
+	semiSplay_=other.semiSplay_;
+	return *this;
+}
+
+template<class Key, class Value>
+void SplayTree<Key, Value>::setSemiSplay(bool semiSplay)
+{
+	semiSplay_=semiSplay;
+}
+
+template<class Key, class Value>
+bool SplayTree<Key, Value>::isSemiSplay() const
+{
+	return semiSplay_;
+}
+
+/**
+* Moves current up towards the root. The zig-zig case rotates the grandparent
+* first, which is what keeps the amortized cost logarithmic.
+*/
+template<class Key, class Value>
+void SplayTree<Key, Value>::splay(Node<Key, Value> *current)
+{
+	while (current->getParent()!=nullptr){
+		Node<Key, Value> *parent= current->getParent();
+		Node<Key, Value> *grandParent= parent->getParent();
+		bool currentIsLeft= (parent->getLeft()==current);
+
+		//ZIG: parent is the root, one rotation and we are done
+		if (grandParent==nullptr){
+			if (currentIsLeft){
+				rightRotation(parent);
+			}else{
+				leftRotation(parent);
+			}
+			return;
+		}
+
+		bool parentIsLeft= (grandParent->getLeft()==parent);
+
+		//ZIG-ZIG: both on the same side
+		if (currentIsLeft==parentIsLeft){
+			if (currentIsLeft){
+				rightRotation(grandParent);
+			}else{
+				leftRotation(grandParent);
+			}
+			//Semi-splay stops this step here and carries on from the parent
+			if (semiSplay_){
+				current=parent;
+				continue;
+			}
+			if (currentIsLeft){
+				rightRotation(parent);
+			}else{
+				leftRotation(parent);
+			}
+		}
+		//ZIG-ZAG: opposite sides
+		else{
+			if (currentIsLeft){
+				rightRotation(parent);
+				leftRotation(grandParent);
+			}else{
+				leftRotation(parent);
+				rightRotation(grandParent);
+			}
+		}
+	}
+}
+
+/**
+* Looks for key and splays the node it ends on. On a miss that is the
+* last node visited, so repeated misses around the same spot get cheap too.
+* Returns NULL if the key is not in the tree.
+*/
+template<class Key, class Value>
+Node<Key, Value>* SplayTree<Key, Value>::splayFind(const Key& key)
+{
+	Node<Key, Value> *temp= this->root_;
+	Node<Key, Value> *last= nullptr;
+	while (temp!=nullptr){
+		BST_COUNT(nodesVisited, 1);
+		BST_COUNT(comparisons, 1);
+		last=temp;
+		if (key<temp->getKey()){
+			temp=temp->getLeft();
+		}
+		else if (BST_COUNT(comparisons, 1), temp->getKey()<key){
+			temp=temp->getRight();
+		}
+		else{
+			break;
+		}
+	}
+	if (last!=nullptr){
+		splay(last);
+	}
+	return temp;
+}
+
+/**
+* Returns an iterator to the item with the given key, or end() if it does not exist.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+SplayTree<Key, Value>::find(const Key& key)
+{
+	BST_COUNT(operations, 1);
+	return this->makeIterator(splayFind(key));
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value>
+Value& SplayTree<Key, Value>::operator[](const Key& key)
+{
+	BST_COUNT(operations, 1);
+	Node<Key, Value> *curr= splayFind(key);
+	if(curr == NULL) throw std::out_of_range("Invalid key");
+	return curr->getValue();
+}
+
+/*
+ * If key is already in the tree, the current value is overwritten
+ * with the updated value. Either way the node ends up splayed.
+ */
+template<class Key, class Value>
+void SplayTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+{
+	BST_COUNT(operations, 1);
+	const Key& keyNew=new_item.first;
+
+	Node<Key, Value> *temp= this->root_;
+	Node<Key, Value> *parent= nullptr;
+	while (temp!=nullptr){
+		BST_COUNT(nodesVisited, 1);
+		BST_COUNT(comparisons, 1);
+		parent=temp;
+		if (keyNew<temp->getKey()){
+			temp=temp->getLeft();
+		}
+		else if (BST_COUNT(comparisons, 1), temp->getKey()<keyNew){
+			temp=temp->getRight();
+		}
+		else{ //If KEY found we update the VALUE
+			temp->setValue(new_item.second);
+			splay(temp);
+			return;
+		}
+	}
+
+	Node<Key, Value> *toInsert= this->template makeNode<Node<Key, Value> >(keyNew, new_item.second, parent);
+	if (parent==nullptr){
+		this->root_=toInsert;
+	}
+	else if (keyNew<parent->getKey()){
+		parent->setLeft(toInsert);
+	}else{
+		parent->setRight(toInsert);
+	}
+	splay(toInsert);
+}
+
+/*
+ * Like the other trees, if a node has 2 children we swap with the
+ * predecessor and then remove. The removed node's parent is splayed.
+ */
+template<class Key, class Value>
+void SplayTree<Key, Value>::remove(const Key& key)
+{
+	BST_COUNT(operations, 1);
+	Node<Key, Value> *current= this->root_;
+	Node<Key, Value> *last= nullptr;
+	while (current!=nullptr){
+		BST_COUNT(nodesVisited, 1);
+		BST_COUNT(comparisons, 1);
+		if (key<current->getKey()){
+			last=current;
+			current=current->getLeft();
+		}
+		else if (BST_COUNT(comparisons, 1), current->getKey()<key){
+			last=current;
+			current=current->getRight();
+		}
+		else{
+			break;
+		}
+	}
+
+	//CASE 1: node does not exist, we still splay where the search ended
+	if (current==nullptr){
+		if (last!=nullptr){
+			splay(last);
+		}
+		return;
+	}
+
+	//CASE 2: There are two children, after the swap current has at most one child
+	if (current->getLeft()!=nullptr && current->getRight()!=nullptr){
+		this->nodeSwap(current, this->predecessor(current));
+	}
+
+	Node<Key, Value> *parent= current->getParent();
+	Node<Key, Value> *child= current->getLeft();
+	if (child==nullptr){
+		child=current->getRight();
+	}
+
+	if (child!=nullptr){
+		child->setParent(parent);
+	}
+	if (parent==nullptr){
+		this->root_=child;
+	}
+	else if (parent->getLeft()==current){
+		parent->setLeft(child);
+	}else{
+		parent->setRight(child);
+	}
+	this->freeNode(current);
+
+	if (parent!=nullptr){
+		splay(parent);
+	}
+}
+
+
+#endif
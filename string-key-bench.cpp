@@ -0,0 +1,95 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "avlbst.h"
+#include "bench-utils.h"
+
+using namespace std;
+
+// Lookups of std::string keys, which keep an 8 character prefix in every node
+// (see NodeKeyPrefix in bst.h), against the same strings wrapped in a type
+// without one. Keys are symbol-like names too long for the small string
+// buffer, once with random leading characters and once all starting with the
+// same namespace, where the prefix can not tell them apart.
+// Usage: ./string-key-bench [numKeys] [numLookups]
+
+struct WrappedString
+{
+    string s;
+    WrappedString() {}
+    WrappedString(const string& x) : s(x) {}
+    bool operator<(const WrappedString& o) const { return s < o.s; }
+    bool operator>(const WrappedString& o) const { return s > o.s; }
+    bool operator==(const WrappedString& o) const { return s == o.s; }
+};
+
+// Needed by the tree's print()
+ostream& operator<<(ostream& out, const WrappedString& k)
+{
+    return out << k.s;
+}
+
+string symbolName(BenchRandom& rng, const string& lead)
+{
+    static const char letters[] = "abcdefghijklmnopqrstuvwxyz_0123456789";
+    string name = lead;
+    size_t length = 20 + rng.below(20);
+    while(name.size() < length) {
+        name += letters[rng.below(sizeof(letters) - 1)];
+    }
+    return name;
+}
+
+template<class Key>
+struct LookupRun
+{
+    LookupRun(const vector<string>& k, const vector<string>& l) : keys(k), lookups(l) {}
+
+    double operator()() const
+    {
+        AVLTree<Key, uint64_t> tree;
+        for(size_t i = 0; i < keys.size(); ++i) {
+            tree.insert(make_pair(Key(keys[i]), i));
+        }
+        vector<Key> probes(lookups.begin(), lookups.end());
+        BenchTimer timer;
+        uint64_t found = 0;
+        for(size_t i = 0; i < probes.size(); ++i) {
+            found += (tree.find(probes[i]) != tree.end());
+        }
+        double secs = timer.elapsedSec();
+        benchKeep(found);
+        return secs * 1e9 / probes.size();
+    }
+
+    const vector<string>& keys;
+    const vector<string>& lookups;
+};
+
+int main(int argc, char *argv[])
+{
+    uint64_t numKeys = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    uint64_t numLookups = argc > 2 ? strtoull(argv[2], NULL, 10) : 2000000;
+
+    cout << "keys,lookups,names,generic_ns,prefix_ns,speedup" << endl;
+    const char* leads[] = { "", "project::detail::" };
+    const char* names[] = { "random", "shared_prefix" };
+    for(int l = 0; l < 2; ++l) {
+        BenchRandom rng(1);
+        vector<string> keys(numKeys);
+        for(size_t i = 0; i < keys.size(); ++i) {
+            keys[i] = symbolName(rng, leads[l]);
+        }
+        // Half of the lookups are for keys in the tree
+        vector<string> lookups(numLookups);
+        for(size_t i = 0; i < lookups.size(); ++i) {
+            lookups[i] = (i % 2) ? keys[rng.below(keys.size())] : symbolName(rng, leads[l]);
+        }
+        double generic = runIsolated(LookupRun<WrappedString>(keys, lookups));
+        double prefixed = runIsolated(LookupRun<string>(keys, lookups));
+        cout << numKeys << "," << numLookups << "," << names[l] << "," << generic << ","
+             << prefixed << "," << generic / prefixed << endl;
+    }
+    return 0;
+}
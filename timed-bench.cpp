@@ -0,0 +1,98 @@
+#include <iostream>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "avlbst.h"
+#include "timed-tree.h"
+#include "bench-utils.h"
+
+using namespace std;
+
+// Measures what the TimedTree wrapper costs on top of a plain AVLTree at a
+// few sampling rates, then prints the merged summary of a multi-threaded
+// lookup run.
+// Usage: ./timed-bench [numKeys] [numThreads]
+
+template<typename Tree>
+double runOnce(Tree& tree, const vector<uint64_t>& keys, const vector<uint64_t>& lookups)
+{
+    BenchTimer timer;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    uint64_t found = 0;
+    for(size_t i = 0; i < lookups.size(); ++i) {
+        found += (tree.find(lookups[i]) != tree.end());
+    }
+    for(size_t i = 0; i < keys.size(); i += 2) {
+        tree.remove(keys[i]);
+    }
+    benchKeep(found);
+    return timer.elapsedSec();
+}
+
+// The plain tree takes the same constructor argument as the wrapper
+struct PlainTree : public AVLTree<uint64_t, uint64_t>
+{
+    explicit PlainTree(unsigned) {}
+};
+
+template<typename Tree>
+double run(unsigned sampleEvery, const vector<uint64_t>& keys, const vector<uint64_t>& lookups)
+{
+    Tree tree(sampleEvery);
+    return runOnce(tree, keys, lookups);
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t numKeys = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    unsigned numThreads = argc > 2 ? atoi(argv[2]) : 4;
+
+    vector<uint64_t> keys = shuffledKeys(numKeys, 1);
+    vector<uint64_t> lookups = shuffledKeys(numKeys, 2);
+
+    cout << "variant,keys,seconds,overhead_pct" << endl;
+    // The variants take turns and the best round of each is kept, so machine
+    // noise and heap layout hit all of them alike
+    unsigned rates[] = { 1, 16, 128 };
+    double best[4] = { 0, 0, 0, 0 };
+    for(int round = 0; round < 5; ++round) {
+        for(int v = 0; v < 4; ++v) {
+            double secs = (v == 0) ? run<PlainTree>(1, keys, lookups)
+                                   : run<TimedTree<uint64_t, uint64_t> >(rates[v - 1], keys, lookups);
+            if(round == 0 || secs < best[v]) best[v] = secs;
+        }
+    }
+    cout << "AVLTree," << numKeys << "," << best[0] << ",0" << endl;
+    for(int v = 1; v < 4; ++v) {
+        cout << "TimedTree-sample" << rates[v - 1] << "," << numKeys << "," << best[v] << ","
+             << (best[v] / best[0] - 1.0) * 100.0 << endl;
+    }
+
+    // Concurrent lookups, each thread records into its own histograms
+    TimedTree<uint64_t, uint64_t> shared(16);
+    for(size_t i = 0; i < keys.size(); ++i) {
+        shared.tree().insert(make_pair(keys[i], keys[i]));
+    }
+    vector<thread> threads;
+    for(unsigned t = 0; t < numThreads; ++t) {
+        threads.push_back(thread([&shared, &lookups, t, numThreads]() {
+            uint64_t found = 0;
+            for(size_t i = t; i < lookups.size(); i += numThreads) {
+                found += (shared.find(lookups[i]) != shared.end());
+            }
+            benchKeep(found);
+        }));
+    }
+    for(size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+    uint64_t scanned = 0;
+    for(TimedTree<uint64_t, uint64_t>::iterator it = shared.begin(); it != shared.end(); ++it) {
+        scanned += it->second;
+    }
+    benchKeep(scanned);
+    cerr << "\n" << numThreads << " threads, sampling 1 in 16:\n" << shared.summary();
+    return 0;
+}
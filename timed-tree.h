@@ -0,0 +1,345 @@
+#ifndef TIMED_TREE_H
+#define TIMED_TREE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "avlbst.h"
+#include "latency-histogram.h"
+
+/**
+* The operations a TimedTree keeps latency histograms for.
+*/
+enum class TreeOp { Insert, Remove, Find, Iterate };
+
+/**
+* An optional timing wrapper around a tree (an AVLTree by default). It
+* forwards insert, remove, find and iteration to the tree and records how
+* long they took in a LatencyHistogram per operation.
+*
+* Every thread records into its own set of histograms, so recording never
+* contends; histogram() and summary() merge all threads when they are read.
+* Only every sampleEvery-th operation of a thread is timed, which keeps the
+* clock reads (the main cost) off most operations. The wrapper adds no
+* locking around the tree itself, the tree's own rules still apply.
+*/
+template <class Key, class Value, class Tree = AVLTree<Key, Value> >
+class TimedTree
+{
+public:
+    class iterator;
+
+    explicit TimedTree(unsigned sampleEvery = 1);
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    iterator find(const Key& key);
+    iterator begin();
+    iterator end();
+
+    // The wrapped tree, for calls that should not be timed
+    Tree& tree();
+    const Tree& tree() const;
+
+    void setSampleEvery(unsigned sampleEvery);
+    unsigned getSampleEvery() const;
+
+    // All threads merged together
+    LatencyHistogram histogram(TreeOp op) const;
+    std::string summary() const;
+    void resetHistograms();
+
+    /**
+    * Iterator over the wrapped tree whose ++ is timed as TreeOp::Iterate.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class TimedTree<Key, Value, Tree>;
+        iterator(typename Tree::iterator it, TimedTree<Key, Value, Tree>* owner);
+        typename Tree::iterator it_;
+        TimedTree<Key, Value, Tree>* owner_;
+    };
+
+protected:
+    static const int kNumOps = 4;
+
+    // The histograms one thread records into
+    struct Shard
+    {
+        Shard() : opCount(0) {}
+        LatencyHistogram histograms[kNumOps];
+        uint64_t opCount;
+    };
+
+    // Starts a timing if this operation is sampled, returns 0 otherwise
+    uint64_t sampleStart(Shard*& shard);
+    void sampleStop(Shard* shard, TreeOp op, uint64_t start);
+    Shard* localShard();
+    static uint64_t nowNs();
+
+    Tree tree_;
+    std::atomic<unsigned> sampleEvery_;
+    uint64_t id_;
+    mutable std::mutex shardsLock_;
+    std::vector<std::unique_ptr<Shard> > shards_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the TimedTree class.
+  -------------------------------------------------
+*/
+
+/**
+* Wrapped trees get a process wide unique id so a thread's shard cache can
+* never confuse a destroyed wrapper with a new one at the same address.
+*/
+inline uint64_t nextTimedTreeId()
+{
+    static std::atomic<uint64_t> next(1);
+    return next.fetch_add(1);
+}
+
+template<class Key, class Value, class Tree>
+TimedTree<Key, Value, Tree>::TimedTree(unsigned sampleEvery) :
+    sampleEvery_(sampleEvery == 0 ? 1 : sampleEvery), id_(nextTimedTreeId())
+{
+
+}
+
+template<class Key, class Value, class Tree>
+uint64_t TimedTree<Key, Value, Tree>::nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+* Returns the calling thread's shard, creating it on first use.
+*/
+template<class Key, class Value, class Tree>
+typename TimedTree<Key, Value, Tree>::Shard* TimedTree<Key, Value, Tree>::localShard()
+{
+	//Most calls hit the one entry cache, the map is for threads using several wrappers
+	static thread_local uint64_t cachedId = 0;
+	static thread_local Shard* cachedShard = nullptr;
+	static thread_local std::map<uint64_t, Shard*> shardsById;
+	if (cachedId==id_){
+		return cachedShard;
+	}
+
+	typename std::map<uint64_t, Shard*>::iterator it= shardsById.find(id_);
+	Shard* shard;
+	if (it!=shardsById.end()){
+		shard=it->second;
+	}else{
+		std::lock_guard<std::mutex> guard(shardsLock_);
+		shards_.push_back(std::unique_ptr<Shard>(new Shard()));
+		shard=shards_.back().get();
+		shardsById[id_]=shard;
+	}
+	cachedId=id_;
+	cachedShard=shard;
+	return shard;
+}
+
+template<class Key, class Value, class Tree>
+uint64_t TimedTree<Key, Value, Tree>::sampleStart(Shard*& shard)
+{
+	shard=localShard();
+	if (++shard->opCount % sampleEvery_.load(std::memory_order_relaxed)!=0){
+		return 0;
+	}
+	return nowNs();
+}
+
+template<class Key, class Value, class Tree>
+void TimedTree<Key, Value, Tree>::sampleStop(Shard* shard, TreeOp op, uint64_t start)
+{
+	if (start!=0){
+		shard->histograms[static_cast<int>(op)].record(nowNs()-start);
+	}
+}
+
+template<class Key, class Value, class Tree>
+void TimedTree<Key, Value, Tree>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+	Shard* shard;
+	uint64_t start= sampleStart(shard);
+	tree_.insert(keyValuePair);
+	sampleStop(shard, TreeOp::Insert, start);
+}
+
+template<class Key, class Value, class Tree>
+void TimedTree<Key, Value, Tree>::remove(const Key& key)
+{
+	Shard* shard;
+	uint64_t start= sampleStart(shard);
+	tree_.remove(key);
+	sampleStop(shard, TreeOp::Remove, start);
+}
+
+template<class Key, class Value, class Tree>
+typename TimedTree<Key, Value, Tree>::iterator TimedTree<Key, Value, Tree>::find(const Key& key)
+{
+	Shard* shard;
+	uint64_t start= sampleStart(shard);
+	typename Tree::iterator it= tree_.find(key);
+	sampleStop(shard, TreeOp::Find, start);
+	return iterator(it, this);
+}
+
+template<class Key, class Value, class Tree>
+typename TimedTree<Key, Value, Tree>::iterator TimedTree<Key, Value, Tree>::begin()
+{
+	return iterator(tree_.begin(), this);
+}
+
+template<class Key, class Value, class Tree>
+typename TimedTree<Key, Value, Tree>::iterator TimedTree<Key, Value, Tree>::end()
+{
+	return iterator(tree_.end(), this);
+}
+
+template<class Key, class Value, class Tree>
+Tree& TimedTree<Key, Value, Tree>::tree()
+{
+	return tree_;
+}
+
+template<class Key, class Value, class Tree>
+const Tree& TimedTree<Key, Value, Tree>::tree() const
+{
+	return tree_;
+}
+
+/**
+* Times one in every sampleEvery operations of each thread (1 times all of them).
+*/
+template<class Key, class Value, class Tree>
+void TimedTree<Key, Value, Tree>::setSampleEvery(unsigned sampleEvery)
+{
+	sampleEvery_.store(sampleEvery == 0 ? 1 : sampleEvery, std::memory_order_relaxed);
+}
+
+template<class Key, class Value, class Tree>
+unsigned TimedTree<Key, Value, Tree>::getSampleEvery() const
+{
+	return sampleEvery_.load(std::memory_order_relaxed);
+}
+
+/**
+* Returns the latencies of op merged over all threads.
+*/
+template<class Key, class Value, class Tree>
+LatencyHistogram TimedTree<Key, Value, Tree>::histogram(TreeOp op) const
+{
+	LatencyHistogram merged;
+	std::lock_guard<std::mutex> guard(shardsLock_);
+	for (size_t i=0; i<shards_.size(); ++i){
+		merged.add(shards_[i]->histograms[static_cast<int>(op)]);
+	}
+	return merged;
+}
+
+/**
+* A text summary with one line per operation.
+*/
+template<class Key, class Value, class Tree>
+std::string TimedTree<Key, Value, Tree>::summary() const
+{
+	static const char* names[kNumOps] = { "insert", "remove", "find", "iterate" };
+	std::string out;
+	for (int op=0; op<kNumOps; ++op){
+		out+=histogram(static_cast<TreeOp>(op)).summary(names[op]);
+		out+="\n";
+	}
+	return out;
+}
+
+/**
+* Clears the histograms of every thread. Meant for quiet moments, a thread
+* recording at the same time may keep a sample or two.
+*/
+template<class Key, class Value, class Tree>
+void TimedTree<Key, Value, Tree>::resetHistograms()
+{
+	std::lock_guard<std::mutex> guard(shardsLock_);
+	for (size_t i=0; i<shards_.size(); ++i){
+		for (int op=0; op<kNumOps; ++op){
+			shards_[i]->histograms[op].reset();
+		}
+	}
+}
+
+/*
+  -------------------------------------------------
+  Begin implementations for the TimedTree::iterator class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value, class Tree>
+TimedTree<Key, Value, Tree>::iterator::iterator() : it_(), owner_(nullptr)
+{
+
+}
+
+template<class Key, class Value, class Tree>
+TimedTree<Key, Value, Tree>::iterator::iterator(typename Tree::iterator it, TimedTree<Key, Value, Tree>* owner) :
+    it_(it), owner_(owner)
+{
+
+}
+
+template<class Key, class Value, class Tree>
+std::pair<const Key,Value>& TimedTree<Key, Value, Tree>::iterator::operator*() const
+{
+    return *it_;
+}
+
+template<class Key, class Value, class Tree>
+std::pair<const Key,Value>* TimedTree<Key, Value, Tree>::iterator::operator->() const
+{
+    return &(*it_);
+}
+
+template<class Key, class Value, class Tree>
+bool TimedTree<Key, Value, Tree>::iterator::operator==(const iterator& rhs) const
+{
+    return it_ == rhs.it_;
+}
+
+template<class Key, class Value, class Tree>
+bool TimedTree<Key, Value, Tree>::iterator::operator!=(const iterator& rhs) const
+{
+    return it_ != rhs.it_;
+}
+
+template<class Key, class Value, class Tree>
+typename TimedTree<Key, Value, Tree>::iterator& TimedTree<Key, Value, Tree>::iterator::operator++()
+{
+	Shard* shard;
+	uint64_t start= owner_->sampleStart(shard);
+	++it_;
+	owner_->sampleStop(shard, TreeOp::Iterate, start);
+	return *this;
+}
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef TREE_RECLAIMER_H
+#define TREE_RECLAIMER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "bst.h"
+
+/**
+* Frees the nodes of cleared trees on a thread of its own, so that clearing a
+* huge tree costs the caller O(1): clear(tree) detaches the nodes and queues
+* them, and the tree can be filled again right away. The worker frees them in
+* slices of sliceBudget steps and lets go of the lock in between, so adding
+* more never waits for a whole tree to be freed.
+*
+* The memory resources of queued nodes must be safe to use from the worker
+* thread and must stay alive until the nodes are freed; wait_idle() or the
+* destructor makes sure of that. The default resource is fine.
+*/
+class TreeReclaimer
+{
+public:
+    explicit TreeReclaimer(size_t sliceBudget = 4096) :
+        sliceBudget_(sliceBudget == 0 ? 1 : sliceBudget), currentLeft_(0), busy_(false), stopping_(false),
+        worker_(&TreeReclaimer::run, this) {}
+    // Frees everything still queued before returning
+    ~TreeReclaimer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        worker_.join();
+    }
+
+    void add(DetachedNodes&& nodes)
+    {
+        if(nodes.empty()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(nodes));
+        }
+        wake_.notify_all();
+    }
+    // Empties tree in O(1) and leaves its nodes to the worker
+    template<class Tree>
+    void clear(Tree& tree) { add(tree.detach_nodes()); }
+
+    // Blocks until every node handed over so far is freed
+    void wait_idle()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this] { return queue_.empty() && !busy_; });
+    }
+    // Nodes queued and not freed yet
+    size_t pending() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t count = 0;
+        for(size_t i = 0; i < queue_.size(); ++i) count += queue_[i].size();
+        return count + currentLeft_;
+    }
+
+private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while(true) {
+            wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if(queue_.empty()) {
+                break;  // stopping with nothing left
+            }
+            current_ = std::move(queue_.front());
+            queue_.pop_front();
+            currentLeft_ = current_.size();
+            busy_ = true;
+            // Only this thread touches current_, the lock is just for currentLeft_
+            while(true) {
+                lock.unlock();
+                bool done = current_.reclaim(sliceBudget_);
+                lock.lock();
+                currentLeft_ = current_.size();
+                if(done) break;
+            }
+            busy_ = false;
+            if(queue_.empty()) {
+                idle_.notify_all();
+            }
+        }
+    }
+
+    size_t sliceBudget_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::deque<DetachedNodes> queue_;
+    DetachedNodes current_;
+    size_t currentLeft_;
+    bool busy_;
+    bool stopping_;
+    std::thread worker_;
+
+    TreeReclaimer(const TreeReclaimer&);
+    TreeReclaimer& operator=(const TreeReclaimer&);
+};
+
+#endif
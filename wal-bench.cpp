@@ -0,0 +1,94 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include "avlbst.h"
+#include "logged-tree.h"
+#include "bench-utils.h"
+
+using namespace std;
+
+// Throughput cost of LoggedTree durability against a plain AVLTree on an
+// update heavy mix (75% inserts, 25% removes), for several group commit
+// sizes, plus the cost of a checkpoint and of recovering from the log.
+// Usage: ./wal-bench [numOps] [directory for the log files]
+
+typedef AVLTree<uint64_t, uint64_t> AVL;
+typedef LoggedTree<uint64_t, uint64_t> Logged;
+
+struct Ops
+{
+    vector<uint64_t> keys;
+    vector<uint8_t> kinds;
+};
+
+template<typename Tree>
+void apply(Tree& tree, const Ops& ops, size_t count)
+{
+    for(size_t i = 0; i < count; ++i) {
+        if(ops.kinds[i] < 3) tree.insert(make_pair(ops.keys[i], i));
+        else tree.remove(ops.keys[i]);
+    }
+}
+
+void removeFiles(const string& path)
+{
+    remove((path + ".log").c_str());
+    remove((path + ".ckpt").c_str());
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t numOps = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    string path = string(argc > 2 ? argv[2] : "/tmp") + "/wal-bench";
+
+    Ops ops;
+    BenchRandom rng(1);
+    for(uint64_t i = 0; i < numOps; ++i) {
+        ops.keys.push_back(rng.below(numOps));
+        ops.kinds.push_back(rng.below(4));
+    }
+
+    cout << "mode,group_commit,ops,seconds,kops_per_sec,overhead" << endl;
+    BenchTimer timer;
+    {
+        AVL tree;
+        apply(tree, ops, numOps);
+    }
+    double base = timer.elapsedSec();
+    cout << "in-memory,-," << numOps << "," << base << "," << numOps / base / 1e3 << ",1" << endl;
+
+    unsigned groups[] = { 1, 16, 256, 4096, 0 };
+    for(int g = 0; g < 5; ++g) {
+        // Syncing every single operation is slow, so it gets fewer of them
+        size_t count = groups[g] == 1 ? min<uint64_t>(numOps, 20000) : numOps;
+        removeFiles(path);
+        timer.restart();
+        {
+            Logged tree(path, groups[g], 0);
+            apply(tree, ops, count);
+            tree.commit();
+        }
+        double secs = timer.elapsedSec();
+        double perOpBase = base / numOps;
+        cout << "logged," << groups[g] << "," << count << "," << secs << "," << count / secs / 1e3 << ","
+             << (secs / count) / perOpBase << endl;
+    }
+
+    // The last run left numOps operations in the log
+    timer.restart();
+    {
+        Logged tree(path, 256, 0);
+        cerr << "recovery from the log: " << timer.elapsedSec() << " s" << endl;
+        timer.restart();
+        tree.checkpoint();
+        cerr << "checkpoint: " << timer.elapsedSec() << " s" << endl;
+    }
+    timer.restart();
+    {
+        Logged tree(path, 256, 0);
+        cerr << "recovery from the checkpoint: " << timer.elapsedSec() << " s" << endl;
+    }
+    removeFiles(path);
+    return 0;
+}